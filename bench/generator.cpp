@@ -0,0 +1,287 @@
+#include "generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "pxtnMem.h"
+#include "pxtnService.h"
+
+bool memoryRead(void *source, void *destination, int size, int num) {
+  auto file = static_cast<MemoryFile *>(source);
+  size_t bytes = (size_t)size * num;
+  if (file->pos + bytes > file->data.size()) return false;
+  memcpy(destination, &file->data[file->pos], bytes);
+  file->pos += bytes;
+  if (_is_big_endian()) {
+    pxtnData::_correct_endian(static_cast<unsigned char *>(destination), size,
+                              num);
+  }
+  return true;
+}
+
+bool memoryWrite(void *source, const void *destination, int size, int num) {
+  auto file = static_cast<MemoryFile *>(source);
+  size_t bytes = (size_t)size * num;
+  if (file->pos + bytes > file->data.size()) file->data.resize(file->pos + bytes);
+  memcpy(&file->data[file->pos], destination, bytes);
+  if (_is_big_endian()) {
+    pxtnData::_correct_endian(&file->data[file->pos], size, num);
+  }
+  file->pos += bytes;
+  return true;
+}
+
+bool memorySeek(void *source, int mode, int size) {
+  auto file = static_cast<MemoryFile *>(source);
+  long pos = mode == SEEK_SET   ? size
+             : mode == SEEK_CUR ? (long)file->pos + size
+                                : (long)file->data.size() + size;
+  if (pos < 0) return false;
+  file->pos = pos;
+  return true;
+}
+
+bool memoryTell(void *source, int32_t *p_pos) {
+  *p_pos = (int32_t) static_cast<MemoryFile *>(source)->pos;
+  return true;
+}
+
+namespace {
+
+// small LCG so the songs do not depend on the standard library.
+struct Random {
+  uint32_t state;
+  int operator()(int n) {
+    state = state * 1103515245u + 12345u;
+    return (int)((state >> 8) % (uint32_t)n);
+  }
+};
+
+// the woice frees them, so they come from pxtnMem.
+void setPoints(pxtnPOINT **points, int num, const int *xs, const int *ys) {
+  pxtnMem_zero_alloc((void **)points, sizeof(pxtnPOINT) * num);
+  for (int i = 0; i < num; i++) {
+    (*points)[i].x = xs[i];
+    (*points)[i].y = ys[i];
+  }
+}
+
+}  // namespace
+
+// overtone and coordinate voices with envelopes; odd flavors loop.
+bool generatePtv(int flavor, MemoryFile *file) {
+  pxtnWoice woice(memoryRead, memoryWrite, memorySeek, memoryTell);
+  if (!woice.Voice_Allocate(2)) return false;
+  for (int v = 0; v < 2; v++) {
+    pxtnVOICEUNIT *voice = woice.get_voice_variable(v);
+    voice->type = (flavor + v) % 2 ? pxtnVOICE_Coodinate : pxtnVOICE_Overtone;
+    voice->voice_flags = flavor % 2 ? PTV_VOICEFLAG_WAVELOOP
+                                    : PTV_VOICEFLAG_WAVELOOP |
+                                          PTV_VOICEFLAG_SMOOTH;
+    if (flavor % 4 == 2) voice->voice_flags |= PTV_VOICEFLAG_BEATFIT;
+    voice->pan = v ? 30 : 90;
+    voice->volume = 100 + v * 20;
+    voice->tuning = 1.0f + v * 0.013f;
+    voice->basic_key = EVENTDEFAULT_BASICKEY + v * 0x80;
+
+    if (voice->type == pxtnVOICE_Overtone) {
+      int num = 5 + v * 3 + flavor % 3;
+      int xs[16], ys[16];
+      for (int i = 0; i < num; i++) {
+        xs[i] = i * 2 + 1;
+        ys[i] = 128 - i * 9;
+      }
+      voice->wave.num = num;
+      voice->wave.reso = 0;
+      setPoints(&voice->wave.points, num, xs, ys);
+    } else {
+      const int xs[7] = {0, 10, 25, 50, 70, 95, 110};
+      const int ys[7] = {0, 90, -30, 60, -127, 40, -10};
+      voice->wave.num = 7;
+      voice->wave.reso = 120;
+      setPoints(&voice->wave.points, 7, xs, ys);
+    }
+
+    const int xs[5] = {0, 37 + v * 11, 120, 333, 250 + v * 90};
+    const int ys[5] = {0, 128, 77, 64, 0};
+    voice->envelope.fps = 1000;
+    voice->envelope.head_num = 4;
+    voice->envelope.body_num = 0;
+    voice->envelope.tail_num = 1;
+    setPoints(&voice->envelope.points, 5, xs, ys);
+    voice->data_flags = PTV_DATAFLAG_WAVE | PTV_DATAFLAG_ENVELOPE;
+  }
+  file->data.clear();
+  file->pos = 0;
+  return woice.PTV_Write(file, nullptr);
+}
+
+// two or three noise units; flavors change the waves and the length.
+bool generatePtn(int flavor, MemoryFile *file) {
+  pxtnPulse_Noise noise(memoryRead, memoryWrite, memorySeek, memoryTell);
+  if (!noise.Allocate(2 + flavor % 2, 3)) return false;
+  noise.set_smp_num_44k(20000 + (flavor % 4) * 9000);
+
+  const pxWAVETYPE mains[4] = {pxWAVETYPE_Random, pxWAVETYPE_Sine,
+                               pxWAVETYPE_Random2, pxWAVETYPE_Saw2};
+  for (int u = 0; u < noise.get_unit_num(); u++) {
+    pxNOISEDESIGN_UNIT *unit = noise.get_unit(u);
+    unit->bEnable = true;
+    unit->pan = u ? -40 : 25 * (flavor % 2);
+    unit->enves[0].x = 0;
+    unit->enves[0].y = 100;
+    unit->enves[1].x = 40 + u * 30;
+    unit->enves[1].y = 70;
+    unit->enves[2].x = 300 + (flavor % 4) * 50;
+    unit->enves[2].y = 0;
+
+    unit->main.type = mains[(u + flavor) % 4];
+    unit->main.freq = 400.f + u * 700 + flavor * 33;
+    unit->main.volume = 60;
+    unit->main.offset = 10 * u;
+    unit->main.b_rev = u & 1;
+    unit->freq.type = flavor % 2 ? pxWAVETYPE_Tri : pxWAVETYPE_Random;
+    unit->freq.freq = 7.5f + u;
+    unit->freq.volume = 30;
+    unit->freq.offset = 0;
+    unit->volu.type = pxWAVETYPE_Rect2;
+    unit->volu.freq = 3.0f + u;
+    unit->volu.volume = 40;
+    unit->volu.offset = 25;
+    unit->volu.b_rev = flavor & 1;
+  }
+  file->data.clear();
+  file->pos = 0;
+  return noise.write(file, nullptr);
+}
+
+// a fading sine with noise.
+bool generatePcm(int ch, int sps, int bps, int sampleNum, MemoryFile *file) {
+  pxtnPulse_PCM pcm(memoryRead, memoryWrite, memorySeek, memoryTell);
+  if (pcm.Create(ch, sps, bps, sampleNum) != pxtnOK) return false;
+
+  Random random = {(uint32_t)(ch * 7 + sps + bps + sampleNum)};
+  auto buffer = static_cast<uint8_t *>(pcm.get_p_buf_variable());
+  for (int i = 0; i < sampleNum; i++) {
+    for (int c = 0; c < ch; c++) {
+      int v = (int)(sin(i * 0.031 * (c + 1)) * 20000 *
+                    (1.0 - (double)i / sampleNum)) +
+              random(2000) - 1000;
+      if (bps == 16)
+        ((int16_t *)buffer)[i * ch + c] = (int16_t)v;
+      else
+        buffer[i * ch + c] = (uint8_t)((v >> 8) + 128);
+    }
+  }
+  file->data.clear();
+  file->pos = 0;
+  return pcm.write(file, nullptr);
+}
+
+bool generateProject(const GeneratorParams &params, MemoryFile *file) {
+  pxtnService pxtn(memoryRead, memoryWrite, memorySeek, memoryTell);
+  if (pxtn.init_collage(pxtnMAX_EVENTNUM) != pxtnOK) return false;
+
+  int measures = std::max(params.measures, 1);
+  pxtn.master->Set(4, 128.0f, 480);
+  pxtn.master->set_meas_num(measures);
+  pxtn.master->set_repeat_meas(measures > 2 ? 2 : 0);
+  pxtn.master->set_last_meas(measures);
+
+  // woices: PTV, PTN and PCM in turn, so any count mixes them.
+  int left[3] = {params.ptvWoices, params.ptnWoices, params.pcmWoices};
+  for (int w = 0; left[0] + left[1] + left[2]; w++) {
+    int type = w % 3;
+    if (!left[type]) continue;
+    left[type]--;
+
+    MemoryFile woice;
+    bool ok = false;
+    pxtnWOICETYPE woiceType = pxtnWOICE_PTV;
+    if (type == 0) {
+      ok = generatePtv(w, &woice);
+    } else if (type == 1) {
+      ok = generatePtn(w, &woice);
+      woiceType = pxtnWOICE_PTN;
+    } else {
+      ok = w % 2 ? generatePcm(2, 11025, 8, 4000 + w * 10, &woice)
+                 : generatePcm(1, 22050, 16, 15000 + w * 100, &woice);
+      woiceType = pxtnWOICE_PCM;
+    }
+    woice.pos = 0;
+    if (!ok || pxtn.Woice_Num() >= pxtn.Woice_Max() ||
+        pxtn.Woice_read(pxtn.Woice_Num(), &woice, woiceType) != pxtnOK)
+      return false;
+    std::string name = "w" + std::to_string(w);
+    pxtn.Woice_Get_variable(pxtn.Woice_Num() - 1)
+        ->set_name_buf(name.c_str(), (int32_t)name.size());
+  }
+  int woiceNum = pxtn.Woice_Num();
+  if (!woiceNum) return false;
+
+  const DELAYUNIT delayUnits[3] = {DELAYUNIT_Beat, DELAYUNIT_Second,
+                                   DELAYUNIT_Meas};
+  for (int d = 0; d < params.delays && d < pxtn.Delay_Max(); d++)
+    pxtn.Delay_Add(delayUnits[d % 3], d % 3 == 1 ? 7.f : 1.f + d, 20.f + d * 13,
+                   d % pxtnMAX_TUNEGROUPNUM);
+  for (int o = 0; o < params.overdrives && o < pxtn.OverDrive_Max(); o++)
+    pxtn.OverDrive_Add(80.f - o * 20, 2.5f - o, (2 + o) % pxtnMAX_TUNEGROUPNUM);
+
+  // units: a voice and group each, then notes with key, pan, volume,
+  // portamento and voice changes. some units fall silent halfway.
+  Random random = {params.seed};
+  pxtnEvelist *evels = pxtn.evels;
+  int measClock = 480 * 4;
+  int step = measClock / std::max(params.eventsPerMeasure, 1);
+  if (step < 4) step = 4;
+  for (int u = 0; u < params.units && u < pxtn.Unit_Max(); u++) {
+    if (!pxtn.Unit_AddNew()) return false;
+    std::string name = "u" + std::to_string(u);
+    pxtn.Unit_Get_variable(u)->set_name_buf(name.c_str(),
+                                            (int32_t)name.size());
+
+    evels->Record_Add_i(0, u, EVENTKIND_VOICENO, u % woiceNum);
+    evels->Record_Add_i(0, u, EVENTKIND_GROUPNO, u % 4);
+    if (u % 5 == 3)
+      evels->Record_Add_i(0, u, EVENTKIND_PAN_TIME, u % 2 ? 84 : 47);
+
+    for (int m = 0; m < measures; m++) {
+      if (u % 7 == 6 && m >= measures / 2) break;
+      for (int clock = m * measClock; clock < (m + 1) * measClock;
+           clock += step) {
+        int c = clock + random(step / 4 + 1);
+        if (!random(4)) continue;
+        int key = 0x3000 + random(36) * 0x100 + random(8) * 0x10;
+        evels->Record_Add_i(c, u, EVENTKIND_KEY, key);
+        if (!random(6))
+          evels->Record_Add_i(c, u, EVENTKIND_PORTAMENT, random(200));
+        if (!random(5))
+          evels->Record_Add_i(c, u, EVENTKIND_PAN_VOLUME, random(128));
+        if (!random(9))
+          evels->Record_Add_i(c, u, EVENTKIND_PAN_TIME, random(128));
+        if (!random(5))
+          evels->Record_Add_i(c, u, EVENTKIND_VELOCITY, 40 + random(88));
+        if (!random(7))
+          evels->Record_Add_i(c, u, EVENTKIND_VOLUME, 40 + random(88));
+        if (!random(11))
+          evels->Record_Add_f(c, u, EVENTKIND_TUNING, 0.9f + random(20) * 0.01f);
+        if (!random(13))
+          evels->Record_Add_i(c, u, EVENTKIND_VOICENO, random(woiceNum));
+        if (!random(17))
+          evels->Record_Add_i(c, u, EVENTKIND_GROUPNO,
+                              random(pxtnMAX_TUNEGROUPNUM));
+        evels->Record_Add_i(c, u, EVENTKIND_ON, 20 + random(step * 2));
+        if (!random(3))
+          evels->Record_Add_i(c + random(step), u, EVENTKIND_KEY,
+                              key + (random(2) ? 1 : -1) * random(12) * 0x100);
+      }
+    }
+  }
+
+  file->data.clear();
+  file->pos = 0;
+  return pxtn.write(file, false, 0) == pxtnOK;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// a song file in memory, read and written through the pxtone I/O callbacks.
+struct MemoryFile {
+  std::vector<uint8_t> data;
+  size_t pos = 0;
+};
+bool memoryRead(void *source, void *destination, int size, int num);
+bool memoryWrite(void *source, const void *destination, int size, int num);
+bool memorySeek(void *source, int mode, int size);
+bool memoryTell(void *source, int32_t *p_pos);
+
+// a synthetic song; the same parameters always give the same file.
+struct GeneratorParams {
+  int units = 16;
+  int measures = 32;
+  int eventsPerMeasure = 8;  // notes per unit and measure, before gaps.
+  int ptvWoices = 4;
+  int ptnWoices = 2;
+  int pcmWoices = 2;
+  int delays = 2;
+  int overdrives = 2;
+  uint32_t seed = 1;
+};
+
+// .ptcop, .ptvoice (two voices), .ptnoise and PCM (.wav) files.
+bool generateProject(const GeneratorParams &params, MemoryFile *file);
+bool generatePtv(int flavor, MemoryFile *file);
+bool generatePtn(int flavor, MemoryFile *file);
+bool generatePcm(int ch, int sps, int bps, int sampleNum, MemoryFile *file);
@@ -0,0 +1,80 @@
+#include "json.hpp"
+
+#include <cctype>
+#include <cstdlib>
+
+const JsonValue &JsonValue::operator[](const std::string &key) const {
+  static const JsonValue none;
+  auto it = object.find(key);
+  return it == object.end() ? none : it->second;
+}
+
+namespace {
+
+struct Parser {
+  const std::string &text;
+  size_t pos = 0;
+
+  void space() {
+    while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+  }
+  bool eat(char c) {
+    space();
+    if (pos >= text.size() || text[pos] != c) return false;
+    pos++;
+    return true;
+  }
+  bool string(std::string *out) {
+    if (!eat('"')) return false;
+    for (; pos < text.size() && text[pos] != '"'; pos++) {
+      if (text[pos] == '\\' && ++pos >= text.size()) return false;
+      *out += text[pos];
+    }
+    return eat('"');
+  }
+  bool value(JsonValue *out) {
+    space();
+    if (pos >= text.size()) return false;
+    char c = text[pos];
+    if (c == '"') {
+      out->type = JsonValue::STRING;
+      return string(&out->string);
+    }
+    if (c == '[') {
+      pos++;
+      out->type = JsonValue::ARRAY;
+      if (eat(']')) return true;
+      do {
+        out->array.emplace_back();
+        if (!value(&out->array.back())) return false;
+      } while (eat(','));
+      return eat(']');
+    }
+    if (c == '{') {
+      pos++;
+      out->type = JsonValue::OBJECT;
+      if (eat('}')) return true;
+      do {
+        std::string key;
+        if (!string(&key) || !eat(':') || !value(&out->object[key]))
+          return false;
+      } while (eat(','));
+      return eat('}');
+    }
+    char *end = nullptr;
+    out->type = JsonValue::NUMBER;
+    out->number = strtod(text.c_str() + pos, &end);
+    if (end == text.c_str() + pos) return false;
+    pos = end - text.c_str();
+    return true;
+  }
+};
+
+}  // namespace
+
+bool parseJson(const std::string &text, JsonValue *value) {
+  Parser parser{text};
+  if (!parser.value(value)) return false;
+  parser.space();
+  return parser.pos == text.size();
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// enough JSON to read back a results file of pxtone-bench.
+struct JsonValue {
+  enum Type { NONE, NUMBER, STRING, ARRAY, OBJECT } type = NONE;
+  double number = 0;
+  std::string string;
+  std::vector<JsonValue> array;
+  std::map<std::string, JsonValue> object;
+
+  // the member 'key', or a NONE value.
+  const JsonValue &operator[](const std::string &key) const;
+};
+
+// false on a syntax error.
+bool parseJson(const std::string &text, JsonValue *value);
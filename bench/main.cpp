@@ -0,0 +1,692 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "generator.hpp"
+#include "json.hpp"
+#include "md5.hpp"
+#include "perf.hpp"
+#include "pxtnService.h"
+
+#define SAMPLE_RATE 44100
+#define CHANNEL_COUNT 2
+
+// clang-format off
+constexpr char usage[] =
+    "Usage: pxtone-bench [options] [file(s)...]\n"
+    "Times pxtone on a generated song and on the given .ptcop files.\n"
+    "Options:\n"
+    "  --units, --measures, --events   Generated song: units, measures and\n"
+    "                                  notes per unit and measure.\n"
+    "  --ptv, --ptn, --pcm             Generated song: woices of each type.\n"
+    "  --delays, --overdrives          Generated song: effects.\n"
+    "  --seed                          Generated song: random seed.\n"
+    "  --save          [file]          Also write the generated song here.\n"
+    "  --repeat, -r    [count]         Runs of each benchmark (default 5).\n"
+    "  --filter        [text]          Only benchmarks whose name has this.\n"
+    "  --json          [file]          Write the results as JSON ('-': stdout).\n"
+    "  --compare       [file]          Compare with an earlier --json file; exit 1\n"
+    "                                  on a slowdown past the threshold.\n"
+    "  --threshold     [percent]       Slowdown allowed by --compare (default 10).\n"
+    "  --kernels       [frames]        Frames per run of the kernel benchmarks\n"
+    "                                  (default 32768; 0: skip them).\n"
+    "  --fixed-phase                   Render with pxtnVOMITPREPFLAG_fixed_phase\n"
+    "                                  (moo benchmarks and --golden).\n"
+    "  --golden        [path]          Check the first file (or the generated\n"
+    "                                  song if none), rendered as\n"
+    "                                  pxtone-renderer's default .wav, against\n"
+    "                                  the hashes in path/*.md5, or in path\n"
+    "                                  if it is one .md5 file.\n"
+    "  --help, -h      Show this dialog.\n"
+;
+// clang-format on
+
+struct Result {
+  std::string name;             // benchmark/subject
+  std::vector<double> seconds;  // one per run
+  double work = 0;              // per run: audio seconds for moo, else items.
+  std::string workUnit;
+  // per run, PerfCounters::COUNT values; empty without counters.
+  std::vector<std::vector<double>> counters;
+  double median() const {
+    std::vector<double> sorted = seconds;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    if (!n) return 0;
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+  }
+  double min() const {
+    return seconds.empty() ? 0
+                           : *std::min_element(seconds.begin(), seconds.end());
+  }
+  // about 95% confidence for the median, from the order statistics of the
+  // runs; any number of runs, no assumed distribution.
+  std::pair<double, double> ci95() const {
+    std::vector<double> sorted = seconds;
+    std::sort(sorted.begin(), sorted.end());
+    int n = (int)sorted.size();
+    if (!n) return {0, 0};
+    int lo = (int)floor(n / 2.0 - 0.98 * sqrt(n));
+    int hi = (int)ceil(n / 2.0 + 0.98 * sqrt(n));
+    lo = std::max(lo, 0);
+    hi = std::min(hi, n - 1);
+    return {sorted[lo], sorted[hi]};
+  }
+  // median of one counter over the runs; -1 when it was not counted.
+  double counter(PerfCounters::Counter c) const {
+    std::vector<double> sorted;
+    for (auto &run : counters)
+      if (run[c] >= 0) sorted.push_back(run[c]);
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    if (!n) return -1;
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+  }
+};
+
+struct BenchConfig {
+  GeneratorParams generator;
+  int repeat = 5;
+  int kernelFrames = 32768;
+  double threshold = 10;  // percent
+  bool fixedPhase = false;
+  std::string filter, jsonPath, savePath, comparePath, goldenDir;
+  std::vector<std::filesystem::path> files;
+};
+
+static double now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+class Bench {
+ public:
+  explicit Bench(const BenchConfig &config) : config(config) {
+    if (!perf.any())
+      std::cerr << "Note: no hardware counters (" << perf.why()
+                << "); timing by the wall clock only." << std::endl;
+  }
+
+  // runs 'body' config.repeat times; 'setup' is not timed.
+  void run(const std::string &name, double work, const std::string &workUnit,
+           const std::function<bool()> &setup,
+           const std::function<bool()> &body) {
+    if (name.find(config.filter) == std::string::npos) return;
+    Result result{name, {}, work, workUnit, {}};
+    for (int r = 0; r < config.repeat; r++) {
+      if (setup && !setup()) return fail(name, "failed in setup");
+      double values[PerfCounters::COUNT];
+      double start = now();
+      perf.start();
+      bool ok = body();
+      perf.stop(values);
+      if (!ok) return fail(name, "failed");
+      result.seconds.push_back(now() - start);
+      if (perf.any())
+        result.counters.emplace_back(values, values + PerfCounters::COUNT);
+    }
+    print(result);
+    results.push_back(result);
+  }
+
+  void fail(const std::string &name, const std::string &reason) {
+    std::cerr << "Error: " << name << ": " << reason << std::endl;
+    failures++;
+  }
+
+  const std::vector<Result> &getResults() const { return results; }
+  bool failed() const { return failures; }
+
+ private:
+  static void print(const Result &result) {
+    char line[256];
+    double median = result.median();
+    snprintf(line, sizeof(line), "%-40s median %10.3f ms  min %10.3f ms",
+             result.name.c_str(), median * 1000, result.min() * 1000);
+    std::cout << line;
+    if (result.work && median) {
+      snprintf(line, sizeof(line), "  %10.1f %s/s", result.work / median,
+               result.workUnit.c_str());
+      std::cout << line;
+    }
+    std::cout << std::endl;
+    if (result.counters.empty()) return;
+
+    // medians per run; misses also per thousand instructions.
+    double cycles = result.counter(PerfCounters::CYCLES);
+    double instructions = result.counter(PerfCounters::INSTRUCTIONS);
+    std::string text = "   ";
+    for (int c = 0; c < PerfCounters::COUNT; c++) {
+      double value = result.counter((PerfCounters::Counter)c);
+      if (value < 0) continue;
+      snprintf(line, sizeof(line), " %s %.0f",
+               PerfCounters::name((PerfCounters::Counter)c), value);
+      text += line;
+      if (c >= PerfCounters::L1D_MISSES && instructions > 0) {
+        snprintf(line, sizeof(line), " (%.2f/ki)", value * 1000 / instructions);
+        text += line;
+      }
+      if (c == PerfCounters::INSTRUCTIONS && cycles > 0) {
+        snprintf(line, sizeof(line), " ipc %.2f", value / cycles);
+        text += line;
+      }
+    }
+    std::cout << text << std::endl;
+  }
+
+  const BenchConfig &config;
+  PerfCounters perf;
+  std::vector<Result> results;
+  int failures = 0;
+};
+
+// read, tones_ready and a full render of one song.
+static void benchSong(Bench &bench, const BenchConfig &config,
+                      const std::string &subject, const MemoryFile &song) {
+  MemoryFile file = song;
+  std::unique_ptr<pxtnService> pxtn;
+  auto load = [&]() {
+    pxtn.reset(new pxtnService(memoryRead, memoryWrite, memorySeek, memoryTell));
+    file.pos = 0;
+    return pxtn->init() == pxtnOK &&
+           pxtn->set_destination_quality(CHANNEL_COUNT, SAMPLE_RATE);
+  };
+
+  // a song this build cannot play (e.g. Ogg woices without Vorbis) is
+  // reported once and skipped.
+  pxtnERR err = load() ? pxtn->read(&file) : pxtnERR_INIT;
+  if (err == pxtnOK) err = pxtn->tones_ready();
+  if (err != pxtnOK) return bench.fail(subject, pxtnError_get_string(err));
+
+  bench.run("read/" + subject, 0, "", load,
+            [&]() { return pxtn->read(&file) == pxtnOK; });
+  auto loadRead = [&]() { return load() && pxtn->read(&file) == pxtnOK; };
+  bench.run("tones_ready/" + subject, 0, "", loadRead,
+            [&]() { return pxtn->tones_ready() == pxtnOK; });
+
+  if (!loadRead() || pxtn->tones_ready() != pxtnOK) return;
+  pxtnVOMITPREPARATION prep = {};
+  prep.master_volume = 0.8f;
+  if (config.fixedPhase) prep.flags |= pxtnVOMITPREPFLAG_fixed_phase;
+  if (!pxtn->moo_preparation(&prep)) return;
+  int32_t frames = pxtn->moo_get_sampling_end();
+  std::vector<int16_t> buffer(4096 * CHANNEL_COUNT);
+  bench.run(
+      "moo/" + subject, (double)frames / SAMPLE_RATE, "audio s",
+      [&]() { return pxtn->moo_preparation(&prep); },
+      [&]() {
+        while (pxtn->Moo(buffer.data(), (int32_t)buffer.size() * 2, nullptr))
+          ;
+        return true;
+      });
+}
+
+// the per-frame kernels of Moo() on their own, each over every unit (or delay)
+// for config.kernelFrames frames from the same point two seconds into the
+// song. Tone_Sample and Tone_Supple see the same voices every frame.
+static void benchKernels(Bench &bench, const BenchConfig &config,
+                         const std::string &subject, const MemoryFile &song) {
+  const int frames = config.kernelFrames;
+  if (frames <= 0) return;
+  MemoryFile file = song;
+  file.pos = 0;
+  pxtnService pxtn(memoryRead, memoryWrite, memorySeek, memoryTell);
+  pxtnPulse_Frequency freq(memoryRead, memoryWrite, memorySeek, memoryTell);
+  pxtnVOMITPREPARATION prep = {};
+  prep.master_volume = 0.8f;
+  if (pxtn.init() != pxtnOK ||
+      !pxtn.set_destination_quality(CHANNEL_COUNT, SAMPLE_RATE) ||
+      pxtn.read(&file) != pxtnOK || pxtn.tones_ready() != pxtnOK ||
+      !pxtn.moo_preparation(&prep) || !freq.Init())
+    return bench.fail("kernel/" + subject, "could not prepare");
+
+  std::vector<int16_t> buffer(SAMPLE_RATE * 2 * CHANNEL_COUNT);
+  pxtn.Moo(buffer.data(), (int32_t)buffer.size() * 2, nullptr);
+  std::vector<uint8_t> state(pxtn.moo_state_size());
+  if (!pxtn.moo_state_save(state.data(), (int32_t)state.size()))
+    return bench.fail("kernel/" + subject, "could not save the state");
+
+  std::vector<pxtnUnit *> units;
+  for (int32_t u = 0; u < pxtn.Unit_Num(); u++)
+    units.push_back(pxtn.Unit_Get_variable(u));
+  std::vector<float> steps(units.size());
+  std::vector<int32_t> groupData(pxtnMAX_CHANNEL * pxtn.Group_Num());
+  int32_t *groups[pxtnMAX_CHANNEL];
+  for (int ch = 0; ch < pxtnMAX_CHANNEL; ch++)
+    groups[ch] = groupData.data() + ch * pxtn.Group_Num();
+  auto restore = [&]() {
+    if (!pxtn.moo_state_load(state.data(), (int32_t)state.size()))
+      return false;
+    for (size_t u = 0; u < units.size(); u++)
+      steps[u] = units[u]->Tone_Increment_Pitch(&freq, 44100.0f / SAMPLE_RATE);
+    std::fill(groupData.begin(), groupData.end(), 0);
+    return true;
+  };
+
+  double work = (double)frames * units.size();
+  bench.run("kernel/Tone_Sample/" + subject, work, "unit frames", restore,
+            [&]() {
+              for (int f = 0; f < frames; f++)
+                for (pxtnUnit *unit : units)
+                  unit->Tone_Sample(false, CHANNEL_COUNT,
+                                    f & (pxtnBUFSIZE_TIMEPAN - 1),
+                                    SAMPLE_RATE / 250, groups);
+              return true;
+            });
+  bench.run("kernel/Tone_Supple/" + subject, work, "unit frames", restore,
+            [&]() {
+              for (int f = 0; f < frames; f++)
+                for (int ch = 0; ch < CHANNEL_COUNT; ch++)
+                  for (pxtnUnit *unit : units)
+                    unit->Tone_Supple(groups[ch], ch,
+                                      f & (pxtnBUFSIZE_TIMEPAN - 1));
+              return true;
+            });
+  bench.run("kernel/Tone_Increment_Sample/" + subject, work, "unit frames",
+            restore, [&]() {
+              for (int f = 0; f < frames; f++)
+                for (size_t u = 0; u < units.size(); u++)
+                  units[u]->Tone_Increment_Sample(steps[u]);
+              return true;
+            });
+
+  if (!pxtn.Delay_Num()) return;
+  bench.run("kernel/Delay_Tone_Supple/" + subject,
+            (double)frames * pxtn.Delay_Num(), "delay frames", restore,
+            [&]() {
+              for (int f = 0; f < frames; f++) {
+                for (int32_t d = 0; d < pxtn.Delay_Num(); d++) {
+                  pxtnDelay *delay = pxtn.Delay_Get(d);
+                  for (int ch = 0; ch < CHANNEL_COUNT; ch++)
+                    delay->Tone_Supple(ch, groups[ch]);
+                  delay->Tone_Increment();
+                }
+              }
+              return true;
+            });
+}
+
+// the woice builders without a song.
+static void benchWoices(Bench &bench) {
+  pxtnPulse_NoiseBuilder builder(memoryRead, memoryWrite, memorySeek,
+                                 memoryTell);
+  if (!builder.Init()) return;
+
+  std::vector<std::unique_ptr<pxtnPulse_Noise>> noises;
+  for (int flavor = 0; flavor < 4; flavor++) {
+    MemoryFile file;
+    if (!generatePtn(flavor, &file)) return;
+    file.pos = 0;
+    noises.emplace_back(
+        new pxtnPulse_Noise(memoryRead, memoryWrite, memorySeek, memoryTell));
+    if (noises.back()->read(&file) != pxtnOK) return;
+  }
+  bench.run("BuildNoise/4 ptnoise", (double)noises.size(), "noises", nullptr,
+            [&]() {
+              for (auto &noise : noises) {
+                pxtnPulse_PCM *pcm =
+                    builder.BuildNoise(noise.get(), CHANNEL_COUNT, SAMPLE_RATE,
+                                       16);
+                if (!pcm) return false;
+                delete pcm;
+              }
+              return true;
+            });
+
+  // private _Convert_SamplePerSecond, by a Convert() that only changes it.
+  const int pcmFrames = 22050 * 10;
+  MemoryFile pcmFile;
+  if (!generatePcm(1, 22050, 16, pcmFrames, &pcmFile)) return;
+  std::unique_ptr<pxtnPulse_PCM> pcm;
+  bench.run(
+      "Convert_SamplePerSecond/22050-44100", (double)pcmFrames / 22050,
+      "audio s",
+      [&]() {
+        pcm.reset(
+            new pxtnPulse_PCM(memoryRead, memoryWrite, memorySeek, memoryTell));
+        pcmFile.pos = 0;
+        return pcm->read(&pcmFile) == pxtnOK;
+      },
+      [&]() { return pcm->Convert(1, SAMPLE_RATE, 16); });
+
+  // private _UpdateWavePTV, by Tone_Ready_sample() of PTV woices.
+  std::vector<std::unique_ptr<pxtnWoice>> woices;
+  for (int flavor = 0; flavor < 4; flavor++) {
+    MemoryFile file;
+    if (!generatePtv(flavor, &file)) return;
+    file.pos = 0;
+    woices.emplace_back(
+        new pxtnWoice(memoryRead, memoryWrite, memorySeek, memoryTell));
+    if (woices.back()->PTV_Read(&file) != pxtnOK) return;
+  }
+  bench.run("UpdateWavePTV/4 ptvoice", (double)woices.size(), "woices",
+            nullptr, [&]() {
+              for (auto &woice : woices)
+                if (woice->Tone_Ready_sample(&builder) != pxtnOK) return false;
+              return true;
+            });
+}
+
+static std::string jsonString(const std::string &str) {
+  std::string out = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') out += '\\';
+    if ((unsigned char)c < 0x20) continue;
+    out += c;
+  }
+  return out + "\"";
+}
+
+static void writeJson(std::ostream &out, const BenchConfig &config,
+                      const std::vector<Result> &results) {
+  const GeneratorParams &g = config.generator;
+  out << "{\n  \"version\": 1,\n  \"repeat\": " << config.repeat
+      << ",\n  \"generator\": {\"units\": " << g.units
+      << ", \"measures\": " << g.measures
+      << ", \"events\": " << g.eventsPerMeasure << ", \"ptv\": " << g.ptvWoices
+      << ", \"ptn\": " << g.ptnWoices << ", \"pcm\": " << g.pcmWoices
+      << ", \"delays\": " << g.delays << ", \"overdrives\": " << g.overdrives
+      << ", \"seed\": " << g.seed << "},\n  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    out << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(r.name)
+        << ", \"median_s\": " << r.median() << ", \"min_s\": " << r.min()
+        << ", \"ci95_s\": [" << r.ci95().first << ", " << r.ci95().second
+        << "]";
+    if (r.work && r.median()) {
+      out << ", \"work\": " << r.work
+          << ", \"work_unit\": " << jsonString(r.workUnit)
+          << ", \"work_per_s\": " << r.work / r.median();
+    }
+    out << ", \"runs_s\": [";
+    for (size_t s = 0; s < r.seconds.size(); s++)
+      out << (s ? ", " : "") << r.seconds[s];
+    out << "]";
+    if (!r.counters.empty()) {
+      out << ", \"counters\": {";
+      const char *separator = "";
+      for (int c = 0; c < PerfCounters::COUNT; c++) {
+        double value = r.counter((PerfCounters::Counter)c);
+        if (value < 0) continue;
+        out << separator
+            << jsonString(PerfCounters::name((PerfCounters::Counter)c)) << ": "
+            << value;
+        separator = ", ";
+      }
+      out << "}";
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+// a slowdown counts when the median is past the threshold and the confidence
+// intervals do not overlap, so noisy runs do not fail the gate.
+static bool compareBaseline(const BenchConfig &config,
+                            const std::vector<Result> &results) {
+  std::ifstream in(config.comparePath);
+  std::string text((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  JsonValue baseline;
+  if (!in || !parseJson(text, &baseline) ||
+      baseline["benchmarks"].type != JsonValue::ARRAY) {
+    std::cerr << "Error: Could not read " << config.comparePath << std::endl;
+    return false;
+  }
+
+  const GeneratorParams &g = config.generator;
+  const JsonValue &base = baseline["generator"];
+  if (base["units"].number != g.units ||
+      base["measures"].number != g.measures ||
+      base["events"].number != g.eventsPerMeasure ||
+      base["ptv"].number != g.ptvWoices || base["ptn"].number != g.ptnWoices ||
+      base["pcm"].number != g.pcmWoices ||
+      base["delays"].number != g.delays ||
+      base["overdrives"].number != g.overdrives ||
+      base["seed"].number != g.seed) {
+    std::cerr << "Error: " << config.comparePath
+              << " was made from another generated song." << std::endl;
+    return false;
+  }
+
+  bool ok = true;
+  std::cout << std::endl << "Compared with " << config.comparePath << ":"
+            << std::endl;
+  for (auto &result : results) {
+    const JsonValue *p_base = nullptr;
+    for (auto &b : baseline["benchmarks"].array)
+      if (b["name"].string == result.name) p_base = &b;
+
+    char line[256];
+    if (!p_base) {
+      snprintf(line, sizeof(line), "%-40s new", result.name.c_str());
+      std::cout << line << std::endl;
+      continue;
+    }
+    double baseMedian = (*p_base)["median_s"].number;
+    const JsonValue &baseCi = (*p_base)["ci95_s"];
+    double baseHi =
+        baseCi.array.size() == 2 ? baseCi.array[1].number : baseMedian;
+    double median = result.median();
+    double change = baseMedian ? (median / baseMedian - 1) * 100 : 0;
+    bool slower = change > config.threshold && result.ci95().first > baseHi;
+    if (slower) ok = false;
+    snprintf(line, sizeof(line), "%-40s %10.3f ms -> %10.3f ms  %+7.1f%%  %s",
+             result.name.c_str(), baseMedian * 1000, median * 1000, change,
+             slower ? "REGRESSION" : "ok");
+    std::cout << line << std::endl;
+  }
+  return ok;
+}
+
+// 'song' as pxtone-renderer writes it by default: looped once at master
+// volume 0.8, 16-bit stereo .wav. --fixed-phase renders it in that mode.
+static bool checkGolden(const BenchConfig &config, const MemoryFile &song) {
+  MemoryFile file = song;
+  file.pos = 0;
+  pxtnService pxtn(memoryRead, memoryWrite, memorySeek, memoryTell);
+  pxtnERR err = pxtn.init();
+  if (err == pxtnOK && !pxtn.set_destination_quality(CHANNEL_COUNT,
+                                                      SAMPLE_RATE))
+    err = pxtnERR_INIT;
+  if (err == pxtnOK) err = pxtn.read(&file);
+  if (err == pxtnOK) err = pxtn.tones_ready();
+  pxtnVOMITPREPARATION prep = {};
+  prep.flags |= pxtnVOMITPREPFLAG_loop;
+  if (config.fixedPhase) prep.flags |= pxtnVOMITPREPFLAG_fixed_phase;
+  prep.master_volume = 0.8f;
+  if (err == pxtnOK && !pxtn.moo_preparation(&prep)) err = pxtnERR_moo_init;
+  if (err != pxtnOK) {
+    std::cerr << "Error: golden: " << pxtnError_get_string(err) << std::endl;
+    return false;
+  }
+
+  uint32_t dataSize = (uint32_t)pxtn.moo_get_sampling_end() * CHANNEL_COUNT * 2;
+  uint8_t header[44];
+  auto put = [&](int pos, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) header[pos + i] = (uint8_t)(v >> (i * 8));
+  };
+  memset(header, 0, sizeof(header));
+  memcpy(header, "RIFF", 4);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  memcpy(header + 36, "data", 4);
+  put(4, 36 + dataSize, 4);
+  put(16, 16, 4);
+  put(20, 1, 2);  // PCM
+  put(22, CHANNEL_COUNT, 2);
+  put(24, SAMPLE_RATE, 4);
+  put(28, SAMPLE_RATE * CHANNEL_COUNT * 2, 4);
+  put(32, CHANNEL_COUNT * 2, 2);
+  put(34, 16, 2);
+  put(40, dataSize, 4);
+
+  Md5 md5;
+  md5.update(header, sizeof(header));
+  std::vector<int16_t> buffer(4096 * CHANNEL_COUNT);
+  for (uint32_t left = dataSize; left;) {
+    uint32_t size = std::min(left, (uint32_t)buffer.size() * 2);
+    pxtn.Moo(buffer.data(), size, nullptr);
+    if (_is_big_endian())
+      pxtnData::_correct_endian((unsigned char *)buffer.data(), 2, size / 2);
+    md5.update(buffer.data(), size);
+    left -= size;
+  }
+  std::string hash = md5.hexDigest();
+
+  std::vector<std::filesystem::path> paths;
+  if (std::filesystem::is_directory(config.goldenDir)) {
+    for (auto &entry : std::filesystem::directory_iterator(config.goldenDir))
+      if (entry.path().extension() == ".md5") paths.push_back(entry.path());
+  } else {
+    paths.push_back(config.goldenDir);
+  }
+  std::vector<std::string> goldens;
+  for (auto &path : paths) {
+    std::ifstream in(path);
+    std::string golden;
+    if (in >> golden) goldens.push_back(golden);
+  }
+  bool match = std::find(goldens.begin(), goldens.end(), hash) != goldens.end();
+  std::cout << std::endl
+            << "Render md5 " << hash
+            << (match ? " matches " : " matches none of the ")
+            << goldens.size() << " in " << config.goldenDir << std::endl;
+  return match;
+}
+
+static bool parseArguments(int argc, char *argv[], BenchConfig *config) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      std::cout << usage << std::endl;
+      return false;
+    }
+    if (arg == "--fixed-phase") {
+      config->fixedPhase = true;
+      continue;
+    }
+    if (arg.empty() || arg[0] != '-') {
+      config->files.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Error: Argument '" << arg << "' requires a parameter."
+                << std::endl;
+      return false;
+    }
+    std::string value = argv[++i];
+    GeneratorParams &g = config->generator;
+    try {
+      if (arg == "--units")
+        g.units = std::stoi(value);
+      else if (arg == "--measures")
+        g.measures = std::stoi(value);
+      else if (arg == "--events")
+        g.eventsPerMeasure = std::stoi(value);
+      else if (arg == "--ptv")
+        g.ptvWoices = std::stoi(value);
+      else if (arg == "--ptn")
+        g.ptnWoices = std::stoi(value);
+      else if (arg == "--pcm")
+        g.pcmWoices = std::stoi(value);
+      else if (arg == "--delays")
+        g.delays = std::stoi(value);
+      else if (arg == "--overdrives")
+        g.overdrives = std::stoi(value);
+      else if (arg == "--seed")
+        g.seed = (uint32_t)std::stoul(value);
+      else if (arg == "--repeat" || arg == "-r")
+        config->repeat = std::max(1, std::stoi(value));
+      else if (arg == "--filter")
+        config->filter = value;
+      else if (arg == "--json")
+        config->jsonPath = value;
+      else if (arg == "--save")
+        config->savePath = value;
+      else if (arg == "--compare")
+        config->comparePath = value;
+      else if (arg == "--threshold")
+        config->threshold = std::stod(value);
+      else if (arg == "--kernels")
+        config->kernelFrames = std::stoi(value);
+      else if (arg == "--golden")
+        config->goldenDir = value;
+      else {
+        std::cerr << "Error: Unknown argument '" << arg << "'" << std::endl;
+        return false;
+      }
+    } catch (const std::exception &) {
+      std::cerr << "Error: Bad value '" << value << "' for " << arg
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  BenchConfig config;
+  if (!parseArguments(argc, argv, &config)) return 1;
+
+  MemoryFile synthetic;
+  if (!generateProject(config.generator, &synthetic)) {
+    std::cerr << "Error: Could not generate the song." << std::endl;
+    return 1;
+  }
+  if (!config.savePath.empty()) {
+    std::ofstream out(config.savePath, std::ios::binary);
+    out.write((const char *)synthetic.data.data(), synthetic.data.size());
+    if (!out) {
+      std::cerr << "Error: Could not write " << config.savePath << std::endl;
+      return 1;
+    }
+  }
+
+  Bench bench(config);
+  std::vector<MemoryFile> songs;
+  benchSong(bench, config, "synthetic", synthetic);
+  benchKernels(bench, config, "synthetic", synthetic);
+  for (auto &path : config.files) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      std::cerr << "Error: Could not open " << path.string() << std::endl;
+      return 1;
+    }
+    songs.emplace_back();
+    songs.back().data.assign(std::istreambuf_iterator<char>(in),
+                             std::istreambuf_iterator<char>());
+    benchSong(bench, config, path.stem().string(), songs.back());
+  }
+  benchWoices(bench);
+
+  bool ok = !bench.failed();
+  if (!config.comparePath.empty() &&
+      !compareBaseline(config, bench.getResults()))
+    ok = false;
+  if (!config.goldenDir.empty() &&
+      !checkGolden(config, songs.empty() ? synthetic : songs.front()))
+    ok = false;
+
+  if (config.jsonPath == "-") {
+    writeJson(std::cout, config, bench.getResults());
+  } else if (!config.jsonPath.empty()) {
+    std::ofstream out(config.jsonPath);
+    writeJson(out, config, bench.getResults());
+    if (!out) {
+      std::cerr << "Error: Could not write " << config.jsonPath << std::endl;
+      return 1;
+    }
+  }
+  return ok ? 0 : 1;
+}
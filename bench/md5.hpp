@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// RFC 1321, to check renders against the md5 files in results/.
+class Md5 {
+ public:
+  Md5();
+  void update(const void *data, size_t size);
+  std::string hexDigest();  // lowercase, as md5sum prints it.
+
+ private:
+  void block(const uint8_t *p);
+
+  uint32_t state[4];
+  uint64_t length = 0;
+  uint8_t buffer[64];
+  size_t buffered = 0;
+};
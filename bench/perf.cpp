@@ -0,0 +1,90 @@
+#include "perf.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *PerfCounters::name(Counter counter) {
+  static const char *names[COUNT] = {"cycles", "instructions", "l1d_misses",
+                                     "llc_misses", "branch_misses"};
+  return names[counter];
+}
+
+#ifdef __linux__
+
+PerfCounters::PerfCounters() {
+  static const uint32_t types[COUNT] = {
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+  static const uint64_t configs[COUNT] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  for (int c = 0; c < COUNT; c++) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[c];
+    attr.config = configs[c];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[c] < 0 && error.empty())
+      error = std::string("perf_event_open: ") + strerror(errno);
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int c = 0; c < COUNT; c++)
+    if (fds[c] >= 0) close(fds[c]);
+}
+
+void PerfCounters::start() {
+  for (int c = 0; c < COUNT; c++) {
+    if (fds[c] < 0) continue;
+    ioctl(fds[c], PERF_EVENT_IOC_RESET, 0);
+    ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void PerfCounters::stop(double *values) {
+  for (int c = 0; c < COUNT; c++)
+    if (fds[c] >= 0) ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+  for (int c = 0; c < COUNT; c++) {
+    values[c] = -1;
+    uint64_t data[3];  // value, time enabled, time running
+    if (fds[c] < 0 || read(fds[c], data, sizeof(data)) != sizeof(data))
+      continue;
+    values[c] = data[2] ? (double)data[0] * data[1] / data[2] : 0;
+  }
+}
+
+#else
+
+PerfCounters::PerfCounters() : error("no perf_event_open on this system") {
+  for (int c = 0; c < COUNT; c++) fds[c] = -1;
+}
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop(double *values) {
+  for (int c = 0; c < COUNT; c++) values[c] = -1;
+}
+
+#endif
+
+bool PerfCounters::any() const {
+  for (int c = 0; c < COUNT; c++)
+    if (fds[c] >= 0) return true;
+  return false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+// hardware counters of the calling thread, from perf_event_open on Linux.
+// counters the kernel or the machine will not give are left out; with none,
+// the benchmarks are timed by the wall clock only.
+class PerfCounters {
+ public:
+  enum Counter {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    COUNT
+  };
+  static const char *name(Counter counter);
+
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool has(Counter counter) const { return fds[counter] >= 0; }
+  bool any() const;
+  const std::string &why() const { return error; }  // when none opened.
+
+  void start();
+  // COUNT values since start(), scaled up if the kernel multiplexed them;
+  // -1 for a counter that is left out.
+  void stop(double *values);
+
+ private:
+  int fds[COUNT];
+  std::string error;
+};
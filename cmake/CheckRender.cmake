@@ -0,0 +1,42 @@
+# Renders SONG with RENDERER into WORK_DIR as the default .wav and checks its
+# md5 against the hashes in GOLDEN_DIR/*.md5 (md5sum format).
+#
+#   cmake -DRENDERER=... -DSONG=... -DGOLDEN_DIR=... -DWORK_DIR=...
+#         -P CheckRender.cmake
+
+foreach(var RENDERER SONG GOLDEN_DIR WORK_DIR)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not set.")
+    endif()
+endforeach()
+
+get_filename_component(SONG_NAME ${SONG} NAME_WE)
+set(OUTPUT ${WORK_DIR}/${SONG_NAME}.wav)
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+execute_process(
+    COMMAND ${RENDERER} -q -o ${WORK_DIR} ${SONG}
+    RESULT_VARIABLE RENDER_RESULT
+)
+if(NOT RENDER_RESULT EQUAL 0 OR NOT EXISTS ${OUTPUT})
+    message(FATAL_ERROR "Could not render ${SONG}.")
+endif()
+file(MD5 ${OUTPUT} HASH)
+
+file(GLOB GOLDEN_FILES ${GOLDEN_DIR}/*.md5)
+set(GOLDENS "")
+foreach(golden ${GOLDEN_FILES})
+    file(STRINGS ${golden} LINES LIMIT_COUNT 1)
+    string(REGEX MATCH "^[0-9a-fA-F]+" GOLDEN "${LINES}")
+    string(TOLOWER "${GOLDEN}" GOLDEN)
+    list(APPEND GOLDENS ${GOLDEN})
+endforeach()
+
+list(FIND GOLDENS ${HASH} FOUND)
+if(FOUND EQUAL -1)
+    string(REPLACE ";" ", " GOLDENS "${GOLDENS}")
+    message(FATAL_ERROR
+        "${SONG_NAME}.wav md5 ${HASH} matches none of ${GOLDENS} in ${GOLDEN_DIR}.")
+endif()
+message(STATUS "${SONG_NAME}.wav md5 ${HASH} matches ${GOLDEN_DIR}.")
@@ -1,13 +1,25 @@
 #include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "pxtnMem.h"
+#include "pxtnSegment.h"
 #include "pxtnService.h"
+#include "pxtnTrace.h"
 #include "sndfile.h"
 
 #pragma pack(1)
@@ -26,12 +38,22 @@ constexpr char usage[] =
     "Usage: pxtone-renderer [options] file(s)...\n"
     "By default, the provided files will be rendered as .wav to your working directory.\n"
     "Options:\n"
-    "  --format, -f        [OGG, WAV, FLAC]    Encode data to this format.\n"
+    "  --format, -f        [OGG, WAV, FLAC]    Encode data to these formats, e.g. wav,flac.\n"
+    "  --depth, -d         [16, 24, float]     Sample format; float is WAV only.\n"
 //    "  --vbr, -v           [0.0 - 1.0]         FLAC/OGG only; Set VBR quality.\n"
 //    "  --compression, -c   [0.0 - 1.0]         FLAC/OGG only; Set compression level.\n"
     "  --fadein            [seconds]           Specify song fade in time.\n"
     "  --loop, -l          Loop the song this many times.\n"
     "  --loop-separately   Separate the song into 'intro' and 'loop' files.\n"
+    "  --threads, -j       [count]             Render each song on this many threads.\n"
+    "  --verify            Compare a threaded render with a single-threaded one.\n"
+    "  --stems             [unit, group]       Also write each unit or group to its own file.\n"
+    "  --stats             Print the time spent in each stage of the conversion\n"
+    "                                          and by each unit, woice and effect,\n"
+    "                                          and pxtone's memory by kind.\n"
+    "  --stats-json        [file]              Write those stats as JSON.\n"
+    "  --trace             [file]              Write a Chrome trace of the stages on each thread\n"
+    "                                          (builds with -DPXTONE_TRACE=ON only).\n"
     "\n"
     "  --output, -o   If 1 file is being rendered, place the resulting file here.\n"
     "                 If multiple are being rendered, put them in this directory.\n"
@@ -60,13 +82,21 @@ struct Config {
     WAV = SF_FORMAT_WAV | SF_FORMAT_PCM_16,
     FLAC = SF_FORMAT_FLAC | SF_FORMAT_PCM_16
   };
-  Format format = WAV;
-  int loopCount = 1;
+  enum Depth { PCM_16, PCM_24, FLOAT };
+  enum Stems { NO_STEMS, UNIT_STEMS, GROUP_STEMS };
+  struct Output {
+    Format format;
+    std::string suffix;
+  };
+  std::vector<Output> outputs = {{WAV, "wav"}};
+  Depth depth = PCM_16;
+  Stems stems = NO_STEMS;
+  int loopCount = 1, threads = 1;
   bool loopSeparately = false, quiet = true, singleFile = true,
-       outputToDirectory = false;
+       outputToDirectory = false, verifyThreads = false, stats = false;
   double fadeInTime = 0 /*, vbrRate = 0, compressionRate = 0*/;
-  std::string formatSuffix = "wav", fileName;
-  std::filesystem::path outputDirectory;
+  std::string fileName;
+  std::filesystem::path outputDirectory, statsJson, trace;
 } static config;
 
 enum LogState : unsigned char { Error, Warning, Info };
@@ -107,18 +137,25 @@ struct KnownArg {
 
 static const KnownArg
     argFormat = {{"--format", "-f"}, true},
+    argDepth = {{"--depth", "-d"}, true},
     //                      argVbr{{"--vbr", "-v"}, true},
     //                      argCompression{{"--compression", "-c"}, true},
     //
     argOutput = {{"--output", "-o"}, true}, argHelp = {{"--help", "-h"}},
     argQuiet{{"--quiet", "-q"}}, argFadeIn{{"--fadein"}, true},
-    argLoop{{"--loop", "-l"}, true}, argLoopSeparately{{"--loop-separately"}};
+    argLoop{{"--loop", "-l"}, true}, argLoopSeparately{{"--loop-separately"}},
+    argThreads{{"--threads", "-j"}, true}, argVerify{{"--verify"}},
+    argStems{{"--stems"}, true}, argStats{{"--stats"}},
+    argStatsJson{{"--stats-json"}, true}, argTrace{{"--trace"}, true};
 
 static const std::vector<KnownArg> knownArguments = {
-    argFormat,        /*argVbr,     argCompression, */ argOutput,
+    argFormat,        argDepth, /*argVbr,     argCompression, */ argOutput,
     argHelp,          argQuiet,
     argFadeIn,        argLoop,
-    argLoopSeparately};
+    argLoopSeparately, argThreads,
+    argVerify,        argStems,
+    argStats,         argStatsJson,
+    argTrace};
 
 KnownArg findArgument(const std::string &key) {
   KnownArg match;
@@ -211,6 +248,53 @@ bool parseArguments(const std::vector<std::string> &args) {
     }
   }
 
+  for (auto it : argThreads.keyMatches) {
+    auto threadsFound = argData.find(it);
+    if (threadsFound != argData.end())
+      config.threads = std::max(1, std::abs(std::stoi(threadsFound->second)));
+  }
+  for (auto it : argVerify.keyMatches) {
+    auto verifyFound = argData.find(it);
+    if (verifyFound != argData.end()) config.verifyThreads = true;
+  }
+  for (auto it : argStems.keyMatches) {
+    auto stemsFound = argData.find(it);
+    if (stemsFound == argData.end() || stemsFound->second.empty()) continue;
+    auto str = stemsFound->second;
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    str == "unit"    ? void(config.stems = Config::UNIT_STEMS)
+    : str == "group" ? void(config.stems = Config::GROUP_STEMS)
+                     : void(logToConsole("Unknown stems '" +
+                                             stemsFound->second +
+                                             "'; Writing no stems",
+                                         LogState::Warning));
+  }
+  for (auto it : argStats.keyMatches)
+    if (argData.find(it) != argData.end()) config.stats = true;
+  for (auto it : argStatsJson.keyMatches) {
+    auto statsJsonFound = argData.find(it);
+    if (statsJsonFound != argData.end())
+      config.statsJson = std::filesystem::absolute(statsJsonFound->second);
+  }
+  for (auto it : argTrace.keyMatches) {
+    auto traceFound = argData.find(it);
+    if (traceFound != argData.end())
+      config.trace = std::filesystem::absolute(traceFound->second);
+  }
+#ifndef pxtnTRACE
+  if (!config.trace.empty()) {
+    logToConsole("Built without PXTONE_TRACE; Ignoring --trace",
+                 LogState::Warning);
+    config.trace.clear();
+  }
+#endif
+  if (config.stems != Config::NO_STEMS && config.threads > 1) {
+    logToConsole("Stems are rendered on one thread; Ignoring --threads",
+                 LogState::Warning);
+    config.threads = 1;
+  }
+
   std::filesystem::path path =
       std::filesystem::absolute(std::filesystem::current_path());
   for (auto it : argOutput.keyMatches) {
@@ -229,22 +313,52 @@ bool parseArguments(const std::vector<std::string> &args) {
     if (formatFound == argData.end() || formatFound->second.empty())
       continue;
     else {
-      auto str = formatFound->second;
-      std::transform(str.begin(), str.end(), str.begin(),
-                     [](unsigned char c) { return std::tolower(c); });
-      auto setFormat = [](Config::Format format, const char *suffix) {
-        config.format = format;
-        config.formatSuffix = suffix;
-      };
-      str == "ogg"   ? setFormat(Config::OGG, "ogg")
-      : str == "wav" ? setFormat(Config::WAV, "wav")
-      : str == "flac"
-          ? setFormat(Config::FLAC, "flac")
-          : void(logToConsole("Unknown format type '" + formatFound->second +
-                                  "'; Resorting to .wav",
-                              LogState::Warning));
+      config.outputs.clear();
+      std::stringstream list(formatFound->second);
+      std::string str;
+      while (std::getline(list, str, ',')) {
+        std::transform(str.begin(), str.end(), str.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        auto addFormat = [](Config::Format format, const char *suffix) {
+          for (auto &output : config.outputs)
+            if (output.format == format) return;
+          config.outputs.push_back({format, suffix});
+        };
+        str == "ogg"   ? addFormat(Config::OGG, "ogg")
+        : str == "wav" ? addFormat(Config::WAV, "wav")
+        : str == "flac"
+            ? addFormat(Config::FLAC, "flac")
+            : void(logToConsole("Unknown format type '" + str + "'; Skipping",
+                                LogState::Warning));
+      }
+      if (config.outputs.empty()) {
+        logToConsole("No known format given; Resorting to .wav",
+                     LogState::Warning);
+        config.outputs.push_back({Config::WAV, "wav"});
+      }
     }
   }
+  for (auto it : argDepth.keyMatches) {
+    auto depthFound = argData.find(it);
+    if (depthFound == argData.end() || depthFound->second.empty()) continue;
+    auto str = depthFound->second;
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    str == "16"      ? void(config.depth = Config::PCM_16)
+    : str == "24"    ? void(config.depth = Config::PCM_24)
+    : str == "float" ? void(config.depth = Config::FLOAT)
+                     : void(logToConsole("Unknown depth '" +
+                                             depthFound->second +
+                                             "'; Resorting to 16",
+                                         LogState::Warning));
+  }
+  bool flac = false;
+  for (auto &output : config.outputs)
+    if (output.format == Config::FLAC) flac = true;
+  if (flac && config.depth == Config::FLOAT) {
+    logToConsole("FLAC has no float samples; Resorting to 24", LogState::Warning);
+    config.depth = Config::PCM_24;
+  }
   return true;
 }
 
@@ -289,7 +403,262 @@ static bool ioTell(void *source, int32_t *p_pos) {
   return true;
 }
 
-void convert(std::filesystem::path file) {
+typedef std::chrono::steady_clock Clock;
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// where the time of one conversion went, for --stats and --stats-json.
+struct Stats {
+  struct Woice {
+    int index;
+    std::string type, name;
+    double seconds;
+  };
+  std::filesystem::path file;
+  double read = 0, preCountEvent = 0, tonesReady = 0, effectsReady = 0,
+         preparation = 0, render = 0, encode = 0, finalize = 0;
+  std::vector<Woice> woices;
+  // what each unit, woice and effect cost the render, on one thread only.
+  struct Cost {
+    std::string kind;
+    int index;
+    std::string name;
+    double seconds;
+    int64_t events, frames;
+  };
+  std::vector<Cost> costs;
+  // pxtnMem by kind: live after tones_ready, and the peak over the file with
+  // every worker's service counted.
+  struct Memory {
+    const char *kind;
+    int64_t bytes, blocks, peak;
+  };
+  std::vector<Memory> memory;
+  int64_t frames = 0;  // rendered, not counting loop passes that were copied.
+  int32_t events = 0;
+  int32_t peakEvents = 0;  // in any one second of the song.
+  uint64_t bytes = 0;
+  Clock::time_point stageStart;
+
+  // the stages of read() and tones_ready() as the service reports them.
+  static void stage(void *user, const pxtnService *pxtn, pxtnSTAGE stage,
+                    int32_t index, bool end) {
+    auto stats = static_cast<Stats *>(user);
+    if (!end) {
+      stats->stageStart = Clock::now();
+      return;
+    }
+    double seconds = secondsSince(stats->stageStart);
+    switch (stage) {
+      case pxtnSTAGE_pre_count_event:
+        stats->preCountEvent += seconds;
+        break;
+      case pxtnSTAGE_delay_ready:
+      case pxtnSTAGE_overdrive_ready:
+        stats->effectsReady += seconds;
+        break;
+      case pxtnSTAGE_woice_ready: {
+        const pxtnWoice *woice = pxtn->Woice_Get(index);
+        int32_t nameSize = 0;
+        const char *name = woice->get_name_buf(&nameSize);
+        const char *type = "none";
+        switch (woice->get_type()) {
+          case pxtnWOICE_PCM:
+            type = "pcm";
+            break;
+          case pxtnWOICE_PTV:
+            type = "ptv";
+            break;
+          case pxtnWOICE_PTN:
+            type = "ptn";
+            break;
+          case pxtnWOICE_OGGV:
+            type = "ogg";
+            break;
+          default:
+            break;
+        }
+        std::string text(name, std::find(name, name + nameSize, '\0'));
+        stats->woices.push_back({index, type, text, seconds});
+        break;
+      }
+    }
+  }
+
+  void takeProfile(pxtnService *pxtn) {
+    double tickSeconds = pxtn->moo_get_profile_tick_sec();
+    auto take = [&](pxtnPROFILEKIND kind, const char *kindName, int num,
+                    auto name) {
+      size_t first = costs.size();
+      for (int i = 0; i < num; i++) {
+        pxtnPROFILECOST cost;
+        if (!pxtn->moo_get_profile(kind, i, &cost)) continue;
+        if (!cost.tick_num && !cost.event_num) continue;
+        costs.push_back({kindName, i, name(i), cost.tick_num * tickSeconds,
+                         cost.event_num, cost.frame_num});
+      }
+      std::sort(costs.begin() + first, costs.end(),
+                [](const Cost &a, const Cost &b) {
+                  return a.seconds > b.seconds;
+                });
+    };
+    auto text = [](const char *buf, int32_t size) {
+      return std::string(buf, std::find(buf, buf + size, '\0'));
+    };
+    take(pxtnPROFILE_unit, "unit", pxtn->Unit_Num(), [&](int i) {
+      int32_t size = 0;
+      const char *name = pxtn->Unit_Get(i)->get_name_buf(&size);
+      return text(name, size);
+    });
+    take(pxtnPROFILE_woice, "woice", pxtn->Woice_Num(), [&](int i) {
+      int32_t size = 0;
+      const char *name = pxtn->Woice_Get(i)->get_name_buf(&size);
+      return text(name, size);
+    });
+    take(pxtnPROFILE_delay, "delay", pxtn->Delay_Num(), [&](int i) {
+      return "group " + std::to_string(pxtn->Delay_Get(i)->get_group());
+    });
+    take(pxtnPROFILE_overdrive, "overdrive", pxtn->OverDrive_Num(), [&](int i) {
+      return "group " + std::to_string(pxtn->OverDrive_Get(i)->get_group());
+    });
+  }
+
+  void takeMemory(bool peak) {
+    static const char *kinds[pxtnMEM_num + 1] = {
+        "other", "events", "voices", "envelopes", "delays", "ogg", "render",
+        "total"};
+    memory.resize(pxtnMEM_num + 1);
+    for (int k = 0; k <= pxtnMEM_num; k++) {
+      pxtnMEMSTAT stat;
+      pxtnMem_get_stat(static_cast<pxtnMEMKIND>(k), &stat);
+      memory[k].kind = kinds[k];
+      if (peak) {
+        memory[k].peak = stat.byte_peak;
+      } else {
+        memory[k].bytes = stat.byte_num;
+        memory[k].blocks = stat.block_num;
+      }
+    }
+  }
+
+  // the most events that fall in one second of the song.
+  void countEvents(const pxtnService *pxtn) {
+    double clocksPerSecond = pxtn->master->get_beat_tempo() *
+                             pxtn->master->get_beat_clock() / 60.0;
+    events = pxtn->evels->get_Count();
+    peakEvents = 0;
+    int32_t inWindow = 0;
+    const EVERECORD *first = pxtn->evels->get_Records();
+    for (auto p = first; p; p = p->next) {
+      inWindow++;
+      while (p->clock - first->clock >= clocksPerSecond) {
+        first = first->next;
+        inWindow--;
+      }
+      peakEvents = std::max(peakEvents, inWindow);
+    }
+  }
+
+  void print() const {
+    auto line = [](const std::string &name, double seconds,
+                   const std::string &note = "") {
+      std::printf("  %-32s %10.3f ms%s\n", name.c_str(), seconds * 1000,
+                  note.c_str());
+    };
+    double audio = static_cast<double>(frames) / SAMPLE_RATE;
+    std::cout << "Stats for " << file.string() << ":" << std::endl;
+    line("read", read);
+    line("  _pre_count_event", preCountEvent);
+    line("tones_ready", tonesReady);
+    line("  delays and overdrives", effectsReady);
+    for (auto &woice : woices)
+      line("  woice " + std::to_string(woice.index) + " " + woice.type + " " +
+               woice.name,
+           woice.seconds);
+    line("moo_preparation", preparation);
+    char note[64];
+    std::snprintf(note, sizeof(note), "  %lld frames, %.1fx realtime",
+                  static_cast<long long>(frames),
+                  render > 0 ? audio / render : 0);
+    line("render", render, note);
+    for (auto &cost : costs) {
+      std::snprintf(note, sizeof(note), "  %5.1f%%, %lld events, %lld frames",
+                    render > 0 ? cost.seconds * 100 / render : 0,
+                    static_cast<long long>(cost.events),
+                    static_cast<long long>(cost.frames));
+      line("  " + cost.kind + " " + std::to_string(cost.index) + " " +
+               cost.name,
+           cost.seconds, note);
+    }
+    line("encode (all files)", encode);
+    line("finalize (all files)", finalize);
+    std::cout << "  " << events << " events, at most " << peakEvents
+              << " in one second; " << bytes << " bytes written" << std::endl;
+    if (!memory.empty())
+      std::cout << "  memory after tones_ready, peak:" << std::endl;
+    for (auto &m : memory)
+      std::printf("    %-10s %12lld bytes in %6lld blocks, %12lld peak\n",
+                  m.kind, static_cast<long long>(m.bytes),
+                  static_cast<long long>(m.blocks),
+                  static_cast<long long>(m.peak));
+  }
+
+  void writeJson(std::ostream &out) const {
+    auto string = [](const std::string &str) {
+      std::string quoted = "\"";
+      for (unsigned char c : str) {
+        if (c == '"' || c == '\\')
+          quoted += std::string("\\") + static_cast<char>(c);
+        else if (c < 0x20) {
+          char escape[8];
+          std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+          quoted += escape;
+        } else
+          quoted += static_cast<char>(c);
+      }
+      return quoted + "\"";
+    };
+    double audio = static_cast<double>(frames) / SAMPLE_RATE;
+    out << "{\"file\": " << string(file.string()) << ", \"read_s\": " << read
+        << ", \"pre_count_event_s\": " << preCountEvent
+        << ", \"tones_ready_s\": " << tonesReady
+        << ", \"effects_ready_s\": " << effectsReady << ", \"woices\": [";
+    for (size_t i = 0; i < woices.size(); i++)
+      out << (i ? ", " : "") << "{\"index\": " << woices[i].index
+          << ", \"type\": " << string(woices[i].type)
+          << ", \"name\": " << string(woices[i].name)
+          << ", \"seconds\": " << woices[i].seconds << "}";
+    out << "], \"costs\": [";
+    for (size_t i = 0; i < costs.size(); i++)
+      out << (i ? ", " : "") << "{\"kind\": " << string(costs[i].kind)
+          << ", \"index\": " << costs[i].index
+          << ", \"name\": " << string(costs[i].name)
+          << ", \"seconds\": " << costs[i].seconds
+          << ", \"events\": " << costs[i].events
+          << ", \"frames\": " << costs[i].frames << "}";
+    out << "], \"moo_preparation_s\": " << preparation
+        << ", \"render_s\": " << render << ", \"encode_s\": " << encode
+        << ", \"finalize_s\": " << finalize << ", \"frames\": " << frames
+        << ", \"realtime_factor\": " << (render > 0 ? audio / render : 0)
+        << ", \"events\": " << events
+        << ", \"peak_events_per_second\": " << peakEvents
+        << ", \"bytes_written\": " << bytes << ", \"memory\": {";
+    for (size_t i = 0; i < memory.size(); i++)
+      out << (i ? ", " : "") << string(memory[i].kind)
+          << ": {\"bytes\": " << memory[i].bytes
+          << ", \"blocks\": " << memory[i].blocks
+          << ", \"peak_bytes\": " << memory[i].peak << "}";
+    out << "}}";
+  }
+};
+static std::vector<Stats> allStats;
+
+// a service with the song read and its tones ready.
+static pxtnService *loadService(const std::filesystem::path &file,
+                                pxtnDSTFORMAT dstFormat,
+                                Stats *stats = nullptr) {
+  pxtnTRACE_SCOPE("load", -1);
   FILE *fp = fopen(file.string().c_str(), "rb");
   if (fp == nullptr)
     throw GetError::file("Error opening file " + file.string() +
@@ -298,26 +667,204 @@ void convert(std::filesystem::path file) {
   // thanks to pxtone update 220910a, we can get rid of pxtnDescriptor entirely
   // & just implement I/O callbacks
   pxtnService *pxtn = new pxtnService(ioRead, ioWrite, ioSeek, ioTell);
+  auto fail = [&](std::string err) {
+    fclose(fp);
+    delete pxtn;
+    throw GetError::pxtone(err);
+  };
 
   auto err = pxtn->init();
-  if (err != pxtnOK) throw GetError::pxtone(err);
-  if (!pxtn->set_destination_quality(CHANNEL_COUNT, SAMPLE_RATE))
-    throw GetError::pxtone(
-        "Could not set destination quality: " + std::to_string(CHANNEL_COUNT) +
-        " channels, " + std::to_string(SAMPLE_RATE) + "Hz.");
+  if (err != pxtnOK) fail(pxtnError_get_string(err));
+  if (!pxtn->set_destination_quality(CHANNEL_COUNT, SAMPLE_RATE, dstFormat))
+    fail("Could not set destination quality: " +
+         std::to_string(CHANNEL_COUNT) + " channels, " +
+         std::to_string(SAMPLE_RATE) + "Hz.");
 
+  if (stats) {
+    pxtnMem_reset_peak();
+    pxtn->set_stage_callback(Stats::stage, stats);
+  }
+  auto start = Clock::now();
   err = pxtn->read(fp);
-  if (err != pxtnOK) throw GetError::pxtone(err);
+  if (err != pxtnOK) fail(pxtnError_get_string(err));
+  if (stats) stats->read = secondsSince(start);
+  start = Clock::now();
   err = pxtn->tones_ready();
-  if (err != pxtnOK) throw GetError::pxtone(err);
+  if (err != pxtnOK) fail(pxtnError_get_string(err));
+  if (stats) {
+    stats->tonesReady = secondsSince(start);
+    stats->countEvents(pxtn);
+    stats->takeMemory(false);
+    pxtn->set_stage_callback(nullptr, nullptr);
+  }
+  fclose(fp);
+  return pxtn;
+}
 
-  SF_INFO info;
-  info.samplerate = SAMPLE_RATE;
-  info.channels = CHANNEL_COUNT;
-  info.format = config.format;
+// the segmented renderer loads one service per worker thread.
+struct SegmentSource {
+  std::filesystem::path file;
+  pxtnDSTFORMAT dstFormat;
+};
+static pxtnService *newSegmentService(void *user) {
+  auto source = static_cast<SegmentSource *>(user);
+  try {
+    return loadService(source->file, source->dstFormat);
+  } catch (std::string err) {
+    return nullptr;
+  }
+}
+static void deleteSegmentService(void *, pxtnService *pxtn) { delete pxtn; }
 
-  if (!sf_format_check(&info))
-    throw GetError::encoder("Invalid encoder format.");
+// logs how far a threaded render is from the single-threaded one.
+static void verifySegments(const void *threaded, const void *sequential,
+                           size_t items, pxtnDSTFORMAT format) {
+  auto sample = [format](const void *buf, size_t i) -> double {
+    switch (format) {
+      case pxtnDSTFORMAT_int32:
+        return static_cast<const int32_t *>(buf)[i];
+      case pxtnDSTFORMAT_float32:
+        return static_cast<const float *>(buf)[i];
+      default:
+        return static_cast<const int16_t *>(buf)[i];
+    }
+  };
+  size_t differ = 0;
+  double maxDiff = 0;
+  for (size_t i = 0; i < items; i++) {
+    double diff = std::abs(sample(threaded, i) - sample(sequential, i));
+    if (diff == 0) continue;
+    differ++;
+    maxDiff = std::max(maxDiff, diff);
+  }
+  if (!differ)
+    logToConsole("Threaded render matches the sequential render.",
+                 LogState::Info);
+  else
+    logToConsole("Threaded render differs in " + std::to_string(differ) +
+                     " of " + std::to_string(items) +
+                     " samples; largest difference " +
+                     std::to_string(maxDiff) + ".",
+                 LogState::Warning);
+}
+
+// one output file. blocks of the render pass are encoded on the sink's own
+// thread, so the encoders and the synthesis run side by side.
+class Sink {
+ public:
+  typedef std::shared_ptr<const std::vector<char>> Block;
+
+  Sink(const std::filesystem::path &path, SF_INFO info, pxtnDSTFORMAT dstFormat,
+       Stats *stats = nullptr)
+      : path(path), format(dstFormat), stats(stats) {
+    pxtnTRACE_SCOPE("sf_open", -1);
+    file = PLATFORM_SF_OPEN(path.c_str(), SFM_WRITE, &info);
+    if (file == nullptr) throw GetError::encoder(file);
+
+    //    sf_command(file, SFC_SET_COMPRESSION_LEVEL,
+    //    &config.compressionRate,
+    //               sizeof(double));
+    //    sf_command(file, SFC_SET_VBR_ENCODING_QUALITY, &config.vbrRate,
+    //               sizeof(double));
+    sf_command(file, SFC_UPDATE_HEADER_NOW, nullptr, 0);
+    thread = std::thread(&Sink::run, this);
+  }
+  ~Sink() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+    }
+    changed.notify_all();
+    thread.join();
+    pxtnTRACE_SCOPE("finalize", -1);
+    auto start = Clock::now();
+    sf_write_sync(file);
+    sf_close(file);
+    if (stats) {
+      stats->encode += encodeSeconds;
+      stats->finalize += secondsSince(start);
+      std::error_code error;
+      auto size = std::filesystem::file_size(path, error);
+      if (!error) stats->bytes += size;
+    }
+  }
+
+  // waits while the encoder is this far behind.
+  void push(Block block, size_t offset, size_t size) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return pending.size() < maxPending; });
+    pending.push_back({block, offset, size});
+    changed.notify_all();
+  }
+
+ private:
+  struct Piece {
+    Block block;
+    size_t offset, size;
+  };
+  static constexpr size_t maxPending = 2;
+
+  void run() {
+    pxtnTRACE_THREAD("encoder");
+    for (;;) {
+      Piece piece;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return done || !pending.empty(); });
+        if (pending.empty()) return;
+        piece = pending.front();
+        pending.pop_front();
+      }
+      changed.notify_all();
+
+      const char *data = piece.block->data() + piece.offset;
+      pxtnTRACE_SCOPE("encode", static_cast<int32_t>(piece.size));
+      auto start = Clock::now();
+      switch (format) {
+        case pxtnDSTFORMAT_int16:
+          sf_write_short(file, reinterpret_cast<const int16_t *>(data),
+                         piece.size / sizeof(int16_t));
+          break;
+        case pxtnDSTFORMAT_int32:
+          sf_write_int(file, reinterpret_cast<const int32_t *>(data),
+                       piece.size / sizeof(int32_t));
+          break;
+        case pxtnDSTFORMAT_float32:
+          sf_write_float(file, reinterpret_cast<const float *>(data),
+                         piece.size / sizeof(float));
+          break;
+      }
+      encodeSeconds += secondsSince(start);
+    }
+  }
+
+  SNDFILE *file;
+  std::filesystem::path path;
+  pxtnDSTFORMAT format;
+  Stats *stats;
+  double encodeSeconds = 0;  // written by the sink's thread until it ends.
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<Piece> pending;
+  bool done = false;
+};
+
+void convert(std::filesystem::path file) {
+  pxtnTRACE_SCOPE("convert", -1);
+  // rendered straight into the sample type the encoder takes.
+  pxtnDSTFORMAT dstFormat = config.depth == Config::FLOAT ? pxtnDSTFORMAT_float32
+                            : config.depth == Config::PCM_24
+                                ? pxtnDSTFORMAT_int32
+                                : pxtnDSTFORMAT_int16;
+  int bytesPerSample = dstFormat == pxtnDSTFORMAT_int16 ? 2 : 4;
+  size_t frameSize = CHANNEL_COUNT * bytesPerSample;
+  bool keepStats = config.stats || !config.statsJson.empty();
+  Stats stats;
+  stats.file = file;
+  pxtnService *pxtn =
+      loadService(file, dstFormat, keepStats ? &stats : nullptr);
+  SegmentSource source = {file, dstFormat};
 
   std::filesystem::path introPath = config.outputDirectory;
 
@@ -328,91 +875,181 @@ void convert(std::filesystem::path file) {
     if (config.singleFile && !config.fileName.empty())
       introPath += "/" + config.fileName;
     else
-      introPath +=
-          "/" + file.filename().replace_extension(config.formatSuffix).string();
+      introPath += "/" + file.filename()
+                             .replace_extension(config.outputs[0].suffix)
+                             .string();
   }
 
-  auto finalize = [](SNDFILE *pcmFile) {
-    sf_write_sync(pcmFile);
-    sf_close(pcmFile);
+  pxtnVOMITPREPARATION prep = {};
+  prep.flags |= pxtnVOMITPREPFLAG_loop;  // TODO: figure this out
+  prep.master_volume = 0.8f;             // this is probably good
+  prep.fadein_sec = static_cast<float>(config.fadeInTime);
+  auto start = Clock::now();
+  if (!pxtn->moo_preparation(&prep))
+    throw GetError::pxtone("I Have No Mouth, and I Must Moo");
+  stats.preparation = secondsSince(start);
+  if (keepStats && !pxtn->moo_set_profile(true))
+    throw GetError::pxtone("Could not start the render profile.");
+
+  // one pass: the intro up to the repeat point, then the loop section
+  // config.loopCount times.
+  int64_t introFrames = pxtn->moo_get_sampling_repeat();
+  int64_t loopFrames =
+      std::max<int64_t>(0, pxtn->moo_get_sampling_end() - introFrames);
+  int64_t totalFrames = introFrames + loopFrames * config.loopCount;
+
+  // stream 0 is the mix, the rest are the stems.
+  pxtnSTEMMODE stemMode =
+      config.stems == Config::GROUP_STEMS ? pxtnSTEM_group : pxtnSTEM_unit;
+  std::vector<std::string> streamNames = {""};
+  if (config.stems != Config::NO_STEMS) {
+    for (int i = 0; i < pxtn->moo_stem_num(stemMode); i++) {
+      std::string index = std::to_string(i);
+      if (index.size() < 2) index = "0" + index;
+      streamNames.push_back(
+          (stemMode == pxtnSTEM_group ? "_group" : "_unit") + index);
+    }
+  }
+  auto withSuffix = [](std::filesystem::path path, const std::string &suffix) {
+    path.replace_filename(path.filename().stem().string() + suffix +
+                          path.extension().string());
+    return path;
   };
-  auto render = [&pxtn](int measureCount, int startMeas, SNDFILE *pcmFile,
-                        bool loop) {
-    int sampleCount =
-        SAMPLE_RATE * (measureCount * pxtn->master->get_beat_num() /
-                       pxtn->master->get_beat_tempo() * 60);
-    int renderSize = sampleCount * CHANNEL_COUNT * 16 / 8;
-
-    pxtnVOMITPREPARATION prep = {};
-    prep.flags |= pxtnVOMITPREPFLAG_loop;  // TODO: figure this out
-    prep.start_pos_meas = startMeas;
-    prep.master_volume = 0.8f;  // this is probably good
-    prep.fadein_sec = loop ? 0 : static_cast<float>(config.fadeInTime);
-    if (!pxtn->moo_preparation(&prep))
-      throw GetError::pxtone("I Have No Mouth, and I Must Moo");
-
-    if (pcmFile == nullptr) throw GetError::encoder(pcmFile);
-
-    //    sf_command(pcmFile, SFC_SET_COMPRESSION_LEVEL,
-    //    &config.compressionRate,
-    //               sizeof(double));
-    //    sf_command(pcmFile, SFC_SET_VBR_ENCODING_QUALITY, &config.vbrRate,
-    //               sizeof(double));
-    sf_command(pcmFile, SFC_UPDATE_HEADER_NOW, nullptr, 0);
 
-    int16_t *buf = static_cast<int16_t *>(malloc(static_cast<size_t>(renderSize)));
+  // every stream of every format gets one file, or an intro and a loop file.
+  struct Route {
+    Sink *sink;
+    size_t stream;
+    int64_t from, to;
+  };
+  std::vector<std::unique_ptr<Sink>> sinks;
+  std::vector<Route> routes;
+  for (auto &output : config.outputs) {
+    SF_INFO info;
+    info.samplerate = SAMPLE_RATE;
+    info.channels = CHANNEL_COUNT;
+    info.format = output.format;
+    if (output.format != Config::OGG)
+      info.format = (info.format & SF_FORMAT_TYPEMASK) |
+                    (config.depth == Config::FLOAT    ? SF_FORMAT_FLOAT
+                     : config.depth == Config::PCM_24 ? SF_FORMAT_PCM_24
+                                                      : SF_FORMAT_PCM_16);
 
-    //    char *buf =
-    //        static_cast<char *>(malloc(static_cast<size_t>(renderSize + 1)));
-    //    buf[renderSize + 1] = '\0';
+    if (!sf_format_check(&info))
+      throw GetError::encoder("Invalid encoder format.");
 
-    int written = 0;
-    auto mooSection = [&](int len) {
-      while (written < len) {
-        int mooedLength = 0;
-        if (!pxtn->Moo(buf, len - written, &mooedLength))
-          throw "Moo error during rendering. Bytes written so far: " +
-              std::to_string(written);
+    std::filesystem::path formatPath = introPath;
+    if (config.outputs.size() > 1) formatPath.replace_extension(output.suffix);
 
-        written += mooedLength;
+    for (size_t stream = 0; stream < streamNames.size(); stream++) {
+      auto path = withSuffix(formatPath, streamNames[stream]);
+      if (config.loopSeparately) {
+        sinks.push_back(std::make_unique<Sink>(withSuffix(path, "_intro"),
+                                               info, dstFormat, &stats));
+        routes.push_back({sinks.back().get(), stream, 0, introFrames});
+        sinks.push_back(std::make_unique<Sink>(withSuffix(path, "_loop"),
+                                               info, dstFormat, &stats));
+        routes.push_back(
+            {sinks.back().get(), stream, introFrames, totalFrames});
+      } else {
+        sinks.push_back(
+            std::make_unique<Sink>(path, info, dstFormat, &stats));
+        routes.push_back({sinks.back().get(), stream, 0, totalFrames});
       }
-    };
-
-    int loopCount = loop ? config.loopCount : 1;
-    for (int i = loopCount; i > 0; i--) {
-      mooSection(renderSize);
-      sf_write_short(pcmFile, buf, renderSize / 2);
     }
-  };
-
-  int lastMeasure = pxtn->master->get_meas_num();
-  if (pxtn->master->get_last_meas())
-    lastMeasure = pxtn->master->get_last_meas();
+  }
 
-  SNDFILE *introFile;
-  SNDFILE *loopFile;
+  // one block per stream, over the same frames.
+  typedef std::vector<Sink::Block> Pass;
 
-  if (config.loopSeparately) {
-    std::filesystem::path loopPath = introPath;
-    introPath.replace_filename(introPath.filename().stem().string() + "_intro" +
-                               introPath.extension().string());
-    loopPath.replace_filename(loopPath.filename().stem().string() + "_loop" +
-                              loopPath.extension().string());
+  // hands the frames of a pass starting at 'pos' to the sinks they fall in.
+  auto feed = [&](const Pass &pass, int64_t pos) {
+    int64_t end = pos + static_cast<int64_t>(pass[0]->size() / frameSize);
+    for (auto &route : routes) {
+      int64_t from = std::max(pos, route.from), to = std::min(end, route.to);
+      if (from < to)
+        route.sink->push(pass[route.stream], (from - pos) * frameSize,
+                         (to - from) * frameSize);
+    }
+  };
+  auto mooFrames = [&](int64_t frames) {
+    auto start = Clock::now();
+    std::vector<std::shared_ptr<std::vector<char>>> blocks;
+    for (size_t stream = 0; stream < streamNames.size(); stream++)
+      blocks.push_back(std::make_shared<std::vector<char>>(frames * frameSize));
+    if (frames && streamNames.size() > 1) {
+      std::vector<void *> stems;
+      for (size_t stream = 1; stream < blocks.size(); stream++)
+        stems.push_back(blocks[stream]->data());
+      if (!pxtn->Moo_stems(stemMode, stems.data(), blocks[0]->data(),
+                           static_cast<int32_t>(frames)))
+        throw GetError::pxtone("Moo error during rendering.");
+    } else if (frames) {
+      int mooedLength = 0;
+      if (!pxtn->Moo(blocks[0]->data(), static_cast<int>(blocks[0]->size()),
+                     &mooedLength))
+        throw GetError::pxtone("Moo error during rendering.");
+    }
+    stats.render += secondsSince(start);
+    stats.frames += frames;
+    return Pass(blocks.begin(), blocks.end());
+  };
 
-    introFile = PLATFORM_SF_OPEN(introPath.c_str(), SFM_WRITE, &info);
-    loopFile = PLATFORM_SF_OPEN(loopPath.c_str(), SFM_WRITE, &info);
+  if (config.threads > 1) {
+    // the whole pass at once, split across the threads.
+    if (totalFrames * frameSize > INT32_MAX)
+      throw GetError::generic("Song is too long to render on threads.");
+    auto all = std::make_shared<std::vector<char>>(totalFrames * frameSize);
+    pxtnSEGMENTPARAM param = {config.threads, 0};
+    auto start = Clock::now();
+    auto err =
+        pxtnSegment_Render(newSegmentService, deleteSegmentService, &source,
+                           &prep, &param, all->data(),
+                           static_cast<int32_t>(all->size()));
+    if (err != pxtnOK) throw GetError::pxtone(err);
+    stats.render = secondsSince(start);
+    stats.frames = totalFrames;
+    if (config.verifyThreads) {
+      Stats threaded = stats;
+      auto sequential = mooFrames(totalFrames);
+      verifySegments(all->data(), sequential[0]->data(),
+                     all->size() / bytesPerSample, dstFormat);
+      stats = threaded;
+    }
+    feed({all}, 0);
   } else {
-    introFile = PLATFORM_SF_OPEN(introPath.c_str(), SFM_WRITE, &info);
-    loopFile = introFile;
-  }
+    feed(mooFrames(introFrames), 0);
 
-  render(pxtn->master->get_repeat_meas(), 0, introFile, false);
-  render((lastMeasure - pxtn->master->get_repeat_meas()),
-         pxtn->master->get_last_meas(), loopFile, true);
-  finalize(introFile);
-  finalize(loopFile);
+    // a pass that ends in the state the pass before it ended in (delays,
+    // time-pan rings and voices alike) is followed by the same pass again,
+    // so every later pass is copied instead.
+    Pass previous;
+    bool converged = false;
+    int32_t stateSize = pxtn->moo_state_size();
+    std::vector<char> state(stateSize), previousState;
+    for (int i = 0; i < config.loopCount; i++) {
+      if (!converged) {
+        previous = mooFrames(loopFrames);
+        if (!pxtn->moo_state_save(state.data(), stateSize))
+          throw GetError::pxtone("Moo error during rendering.");
+        converged = !previousState.empty() &&
+                    pxtn->moo_state_same(previousState.data(), state.data(),
+                                         stateSize);
+        previousState.swap(state);
+        state.resize(stateSize);
+      }
+      feed(previous, introFrames + loopFrames * i);
+    }
+  }
+  sinks.clear();
 
+  if (keepStats && config.threads <= 1) stats.takeProfile(pxtn);
   pxtn->evels->Release();
+  if (keepStats) {
+    stats.takeMemory(true);
+    if (config.stats) stats.print();
+    allStats.push_back(stats);
+  }
 }
 
 int main(int argc, char *argv[]) {
@@ -438,6 +1075,12 @@ int main(int argc, char *argv[]) {
   }
 
   if (!parseArguments(args)) return 0;
+#ifdef pxtnTRACE
+  if (!config.trace.empty()) {
+    pxtnTRACE_THREAD("main");
+    pxtnTrace_Enable(true);
+  }
+#endif
 
   for (auto it : files) {
     auto absolute = std::filesystem::absolute(it);
@@ -449,6 +1092,26 @@ int main(int argc, char *argv[]) {
     else
       logToConsole("File " + it.string() + " not found.", LogState::Warning);
   }
+  if (!config.statsJson.empty()) {
+    std::ofstream out(config.statsJson);
+    out << "[";
+    for (size_t i = 0; i < allStats.size(); i++) {
+      out << (i ? ",\n " : "");
+      allStats[i].writeJson(out);
+    }
+    out << "]" << std::endl;
+    if (!out)
+      return logToConsole("Could not write " + config.statsJson.string());
+  }
+#ifdef pxtnTRACE
+  if (!config.trace.empty()) {
+    FILE *fp = fopen(config.trace.string().c_str(), "wb");
+    bool written = pxtnTrace_Write(fp);
+    if (fp) written = !fclose(fp) && written;
+    if (!written)
+      return logToConsole("Could not write " + config.trace.string());
+  }
+#endif
   return 0;
 }
 
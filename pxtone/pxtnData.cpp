@@ -1,4 +1,5 @@
 #include "./pxtnData.h"
+#include "./pxtnMem.h"
 
 // OPNA2608 & Ewan EDIT start
 // Functions to detect host endianness & correct file I/O data when needed.
@@ -222,3 +223,9 @@ pxtnData::pxtnData() { _b_init = false; }
 void pxtnData::_release() { _b_init = false; }
 
 pxtnData::~pxtnData() { _release(); }
+
+void* pxtnData::operator new(size_t size) noexcept {
+  return pxtnMem_alloc(size, pxtnMEM_other);
+}
+
+void pxtnData::operator delete(void* p) noexcept { pxtnMem_free(&p); }
@@ -54,6 +54,10 @@ public :
 	pxtnData();
 	virtual ~pxtnData();
 
+	// through pxtnMem; NULL when out of memory.
+	static void* operator new   ( size_t size ) noexcept;
+	static void  operator delete( void*  p    ) noexcept;
+
 	bool copy_from( const pxtnData* src );
 
 	bool init();
@@ -72,7 +72,7 @@ pxtnERR pxtnDelay::Tone_Ready( int32_t beat_num, float beat_tempo, int32_t sps )
 
 		for( int32_t c = 0; c < pxtnMAX_CHANNEL; c++ )
 		{
-			if( !pxtnMem_zero_alloc( (void**)&_bufs[ c ], _smp_num * sizeof(int32_t) ) ){ res = pxtnERR_memory; goto term; }
+			if( !pxtnMem_zero_alloc( (void**)&_bufs[ c ], _smp_num * sizeof(int32_t), pxtnMEM_delay ) ){ res = pxtnERR_memory; goto term; }
 		}
 	}
 
@@ -98,6 +98,72 @@ void pxtnDelay::Tone_Increment()
 	if( ++_offset >= _smp_num ) _offset = 0;
 }
 
+// Tone_Supple for 'num' frames of one channel. group_blks holds blk_size frames per group.
+// the ring is walked in spans up to its end, so the inner loop has no wrap test.
+void pxtnDelay::Tone_Supple_Block( int32_t ch, int32_t *group_blks, int32_t blk_size, int32_t num )
+{
+	if( !_smp_num ) return;
+
+	int32_t* p_smp = &group_blks[ _group * blk_size ];
+	int32_t* p_buf = _bufs[ ch ];
+	int32_t  ofs   = _offset;
+
+	for( int32_t i = 0; i < num; )
+	{
+		int32_t span = _smp_num - ofs; if( span > num - i ) span = num - i;
+		int32_t* p_s = &p_smp[ i   ];
+		int32_t* p_b = &p_buf[ ofs ];
+
+		if( _b_played ){ for( int32_t s = 0; s < span; s++ ){ p_s[ s ] += p_b[ s ] * _rate_s32 / 100; p_b[ s ] = p_s[ s ]; } }
+		else           { for( int32_t s = 0; s < span; s++ ){                                          p_b[ s ] = p_s[ s ]; } }
+
+		i   += span;
+		ofs += span; if( ofs >= _smp_num ) ofs = 0;
+	}
+}
+
+void pxtnDelay::Tone_Increment_Block( int32_t num )
+{
+	if( !_smp_num ) return;
+	_offset = ( _offset + num ) % _smp_num;
+}
+
+int32_t pxtnDelay::Tone_Sample_Num() const{ return _smp_num; }
+
+// frames after which the ring, fed only zeros, holds only zeros. -1: never.
+// each pass scales a sample by rate / 100, truncated, and none is over 2^31.
+int32_t pxtnDelay::Tone_Decay_Num() const
+{
+	if( !_smp_num   ) return 0;
+	if( !_b_played  ) return _smp_num;
+
+	int64_t rate = _rate_s32 < 0 ? -(int64_t)_rate_s32 : _rate_s32;
+	if( rate >= 100 ) return -1;
+
+	int64_t num = 0;
+	for( int64_t v = 0x80000000LL; v; v = v * rate / 100 ) num += _smp_num;
+	if( num > 0x7fffffff ) return -1;
+	return (int32_t)num;
+}
+
+// offset and the rings of every channel, for render snapshots.
+int32_t pxtnDelay::Tone_State_Size() const
+{
+	return (int32_t)sizeof(int32_t) * ( 1 + _smp_num * pxtnMAX_CHANNEL );
+}
+
+void pxtnDelay::Tone_State_Get( int32_t* p_state ) const
+{
+	*p_state++ = _offset;
+	for( int32_t c = 0; c < pxtnMAX_CHANNEL && _smp_num; c++, p_state += _smp_num ) memcpy( p_state, _bufs[ c ], _smp_num * sizeof(int32_t) );
+}
+
+void pxtnDelay::Tone_State_Set( const int32_t* p_state )
+{
+	_offset = *p_state++;
+	for( int32_t c = 0; c < pxtnMAX_CHANNEL && _smp_num; c++, p_state += _smp_num ) memcpy( _bufs[ c ], p_state, _smp_num * sizeof(int32_t) );
+}
+
 void  pxtnDelay::Tone_Clear()
 {
 	if( !_smp_num ) return;
@@ -41,6 +41,13 @@ public :
 	pxtnERR Tone_Ready    ( int32_t beat_num, float beat_tempo, int32_t sps );
 	void    Tone_Supple   ( int32_t ch_num  , int32_t *group_smps );
 	void    Tone_Increment();
+	void    Tone_Supple_Block   ( int32_t ch, int32_t *group_blks, int32_t blk_size, int32_t num );
+	void    Tone_Increment_Block( int32_t num );
+	int32_t Tone_Sample_Num     () const;
+	int32_t Tone_Decay_Num      () const;
+	int32_t Tone_State_Size     () const;
+	void    Tone_State_Get      ( int32_t* p_state ) const;
+	void    Tone_State_Set      ( const int32_t* p_state );
 	void    Tone_Release  ();
 	void    Tone_Clear    ();
 
@@ -1,10 +1,11 @@
 
 #include "./pxtnEvelist.h"
 
+#include "./pxtnMem.h"
+
 void pxtnEvelist::Release()
 {
-	if( _eves ) free( _eves );
-	_eves              = NULL;
+	pxtnMem_free( (void**)&_eves );
 	_start             = NULL;
 	_eve_allocated_num =    0;
 }
@@ -35,8 +36,7 @@ void pxtnEvelist::Clear()
 bool pxtnEvelist::Allocate( int32_t max_event_num )
 {
 	pxtnEvelist::Release();
-	if( !(  _eves = (EVERECORD*)malloc( sizeof(EVERECORD) * max_event_num ) ) ) return false;
-	memset( _eves, 0,                   sizeof(EVERECORD) * max_event_num );
+	if( !pxtnMem_zero_alloc( (void**)&_eves, sizeof(EVERECORD) * max_event_num, pxtnMEM_event ) ) return false;
 	_eve_allocated_num = max_event_num;
 	return true;
 }
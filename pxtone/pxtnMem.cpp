@@ -1,9 +1,76 @@
 ﻿
 #include "./pxtnMem.h"
 
-bool pxtnMem_zero_alloc( void** pp, uint32_t byte_size )
+#include <atomic>
+
+// each block starts with its size and kind, so pxtnMem_free() can count it
+// off. 16 bytes keep the caller's part aligned as malloc's is.
+typedef struct
+{
+	size_t  size;
+	int32_t kind;
+}
+_MEMHEAD;
+
+#define _MEMHEAD_SIZE 16
+
+static pxtnMemAlloc _proc_alloc = NULL;
+static pxtnMemFree  _proc_free  = NULL;
+static void*        _user       = NULL;
+
+// [ pxtnMEM_num ] is the sum of the kinds.
+static std::atomic<int64_t> _byte_nums [ pxtnMEM_num + 1 ];
+static std::atomic<int64_t> _byte_peaks[ pxtnMEM_num + 1 ];
+static std::atomic<int64_t> _block_nums[ pxtnMEM_num + 1 ];
+static std::atomic<int64_t> _alloc_nums[ pxtnMEM_num + 1 ];
+
+static void _Peak( int32_t k, int64_t byte_num )
 {
-	if( !(  *pp = malloc( byte_size ) ) ) return false;
+	int64_t peak = _byte_peaks[ k ];
+	while( byte_num > peak && !_byte_peaks[ k ].compare_exchange_weak( peak, byte_num ) ){}
+}
+
+static void _Count( int32_t kind, int64_t byte_size, int32_t block )
+{
+	int32_t ks[ 2 ] = { kind, pxtnMEM_num };
+	for( int32_t i = 0; i < 2; i++ )
+	{
+		int32_t k = ks[ i ];
+		int64_t byte_num = _byte_nums[ k ] += byte_size;
+		_block_nums[ k ] += block;
+		if( block > 0 ){ _alloc_nums[ k ]++; _Peak( k, byte_num ); }
+	}
+}
+
+bool pxtnMem_set_allocator( pxtnMemAlloc proc_alloc, pxtnMemFree proc_free, void* user )
+{
+	if( _block_nums[ pxtnMEM_num ] ) return false;
+	if( !proc_alloc != !proc_free  ) return false;
+	_proc_alloc = proc_alloc;
+	_proc_free  = proc_free ;
+	_user       = user      ;
+	return true;
+}
+
+void* pxtnMem_alloc( size_t byte_size, pxtnMEMKIND kind )
+{
+	if( kind < 0 || kind >= pxtnMEM_num ) kind = pxtnMEM_other;
+
+	uint8_t* p = NULL;
+	if( _proc_alloc ) p = (uint8_t*)_proc_alloc( _user, _MEMHEAD_SIZE + byte_size );
+	else              p = (uint8_t*)malloc     (        _MEMHEAD_SIZE + byte_size );
+	if( !p ) return NULL;
+
+	_MEMHEAD* p_head = (_MEMHEAD*)p;
+	p_head->size = byte_size;
+	p_head->kind = kind     ;
+	_Count( kind, (int64_t)byte_size, 1 );
+	return p + _MEMHEAD_SIZE;
+}
+
+bool pxtnMem_zero_alloc( void** pp, uint32_t byte_size, pxtnMEMKIND kind )
+{
+	if( !(  *pp = pxtnMem_alloc( byte_size, kind ) ) ) return false;
 	memset( *pp, 0,       byte_size );
 	return true;
 }
@@ -11,7 +78,12 @@ bool pxtnMem_zero_alloc( void** pp, uint32_t byte_size )
 bool pxtnMem_free( void** pp )
 {
 	if( !pp || !*pp ) return false;
-	free( *pp ); *pp = NULL;
+	uint8_t*  p      = (uint8_t*)*pp - _MEMHEAD_SIZE;
+	_MEMHEAD* p_head = (_MEMHEAD*)p;
+	_Count( p_head->kind, -(int64_t)p_head->size, -1 );
+	if( _proc_free ) _proc_free( _user, p );
+	else             free      (        p );
+	*pp = NULL;
 	return true;
 }
 
@@ -22,3 +94,18 @@ bool pxtnMem_zero( void*  p , uint32_t byte_size )
 	for( uint32_t i = 0; i < byte_size; i++, p_++ ) *p_ = 0;
 	return true;
 }
+
+bool pxtnMem_get_stat( pxtnMEMKIND kind, pxtnMEMSTAT* p_stat )
+{
+	if( kind < 0 || kind > pxtnMEM_num || !p_stat ) return false;
+	p_stat->byte_num  = _byte_nums [ kind ];
+	p_stat->byte_peak = _byte_peaks[ kind ];
+	p_stat->block_num = _block_nums[ kind ];
+	p_stat->alloc_num = _alloc_nums[ kind ];
+	return true;
+}
+
+void pxtnMem_reset_peak()
+{
+	for( int32_t k = 0; k <= pxtnMEM_num; k++ ) _byte_peaks[ k ] = _byte_nums[ k ].load();
+}
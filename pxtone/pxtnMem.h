@@ -5,8 +5,70 @@
 
 #include "./pxtn.h"
 
-bool pxtnMem_zero_alloc( void** pp, uint32_t byte_size );
-bool pxtnMem_free      ( void** pp );
-bool pxtnMem_zero      ( void*  p , uint32_t byte_size );
+#include <new>
+
+// what a block is for, for the statistics.
+enum pxtnMEMKIND
+{
+	pxtnMEM_other = 0, // objects, tables, names and the rest.
+	pxtnMEM_event    , // event list.
+	pxtnMEM_voice    , // PCM and woice samples, and their conversion work.
+	pxtnMEM_envelope , // envelope points and tables.
+	pxtnMEM_delay    , // delay rings.
+	pxtnMEM_oggv     , // Ogg/Vorbis payloads (not the decoder's own memory).
+	pxtnMEM_moo      , // render buffers, snapshots and stems.
+	pxtnMEM_num      ,
+};
+
+typedef struct
+{
+	int64_t byte_num ; // live now.
+	int64_t byte_peak; // since the start or pxtnMem_reset_peak().
+	int64_t block_num; // live now.
+	int64_t alloc_num; // allocations so far.
+}
+pxtnMEMSTAT;
+
+// must be safe to call from several threads (segmented rendering).
+typedef void* (* pxtnMemAlloc)( void* user, size_t byte_size );
+typedef void  (* pxtnMemFree )( void* user, void*  p         );
+
+// every block pxtone allocates, objects and containers included, comes from
+// here; not counted: the state std::thread keeps for segmented rendering and
+// the spans pxtnTrace records (kept to the end of the process).
+// NULL procs: malloc/free. false while any block is live, so set it before
+// the first pxtone object is made.
+bool  pxtnMem_set_allocator( pxtnMemAlloc proc_alloc, pxtnMemFree proc_free, void* user );
+
+void* pxtnMem_alloc     ( size_t  byte_size, pxtnMEMKIND kind );
+bool  pxtnMem_zero_alloc( void** pp, uint32_t byte_size, pxtnMEMKIND kind = pxtnMEM_other );
+bool  pxtnMem_free      ( void** pp );
+bool  pxtnMem_zero      ( void*  p , uint32_t byte_size );
+
+// kind pxtnMEM_num: all kinds together.
+bool  pxtnMem_get_stat  ( pxtnMEMKIND kind, pxtnMEMSTAT* p_stat );
+void  pxtnMem_reset_peak();
+
+// for std:: containers; throws std::bad_alloc as std::allocator does.
+template <class T, pxtnMEMKIND kind>
+struct pxtnMemAllocator
+{
+	typedef T value_type;
+	template <class U> struct rebind{ typedef pxtnMemAllocator<U, kind> other; };
+
+	pxtnMemAllocator(){}
+	template <class U> pxtnMemAllocator( const pxtnMemAllocator<U, kind>& ){}
+
+	T* allocate( size_t n )
+	{
+		void* p = pxtnMem_alloc( n * sizeof(T), kind );
+		if( !p ) throw std::bad_alloc();
+		return (T*)p;
+	}
+	void deallocate( T* p, size_t ){ void* v = p; pxtnMem_free( &v ); }
+
+	bool operator == ( const pxtnMemAllocator& ) const{ return true ; }
+	bool operator != ( const pxtnMemAllocator& ) const{ return false; }
+};
 
 #endif
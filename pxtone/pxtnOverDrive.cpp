@@ -42,6 +42,19 @@ void pxtnOverDrive::Tone_Supple( int32_t *group_smps ) const
     group_smps[ _group ] = (int32_t)trunc( (float)work * _amp_f );
 }
 
+void pxtnOverDrive::Tone_Supple_Block( int32_t *group_blks, int32_t blk_size, int32_t num ) const
+{
+    if( !_b_played ) return;
+    int32_t* p = &group_blks[ _group * blk_size ];
+    for( int32_t i = 0; i < num; i++ )
+    {
+        int32_t work = p[ i ];
+        if(      work >  _cut_16bit_top ) work =   _cut_16bit_top;
+        else if( work < -_cut_16bit_top ) work =  -_cut_16bit_top;
+        p[ i ] = (int32_t)trunc( (float)work * _amp_f );
+    }
+}
+
 
 // (8byte) =================
 typedef struct
@@ -32,6 +32,7 @@ public :
 
 	void Tone_Ready();
 	void Tone_Supple( int32_t *group_smps ) const;
+	void Tone_Supple_Block( int32_t *group_blks, int32_t blk_size, int32_t num ) const;
 
 	bool    Write( void* desc ) const;
 	pxtnERR Read ( void* desc );
@@ -1,5 +1,6 @@
 ﻿
 #include "./pxtn.h"
+#include "./pxtnMem.h"
 
 #include "./pxtnPulse_Frequency.h"
 
@@ -58,7 +59,7 @@ pxtnPulse_Frequency::pxtnPulse_Frequency( pxtnIO_r io_read, pxtnIO_w io_write, p
 
 pxtnPulse_Frequency::~pxtnPulse_Frequency()
 {
-	if( _freq_table ) free( _freq_table ); _freq_table = NULL;
+	pxtnMem_free( (void**)&_freq_table );
 }
 
 bool pxtnPulse_Frequency::Init()
@@ -89,7 +90,7 @@ bool pxtnPulse_Frequency::Init()
 	double oct_x24;
 	double work;
 
-	if( !( _freq_table = (float*)malloc( sizeof(float) * _TABLE_SIZE ) ) ) goto End;
+	if( !( _freq_table = (float*)pxtnMem_alloc( sizeof(float) * _TABLE_SIZE, pxtnMEM_other ) ) ) goto End;
 
 	oct_x24 = _GetDivideOctaveRate( _KEY_PER_OCTAVE * _FREQUENCY_PER_KEY );
 
@@ -248,7 +248,7 @@ pxtnERR pxtnPulse_Noise::read( void* desc )
 		{
 			if( !_data_r_v( desc, &pU->enve_num ) ){ res = pxtnERR_desc_r; goto term; }
 			if( pU->enve_num > MAX_NOISEEDITENVELOPENUM ){ res = pxtnERR_fmt_unknown; goto term; }
-			if( !pxtnMem_zero_alloc( (void**)&pU->enves, sizeof(pxtnPOINT) * pU->enve_num ) ){ res = pxtnERR_memory; goto term; }
+			if( !pxtnMem_zero_alloc( (void**)&pU->enves, sizeof(pxtnPOINT) * pU->enve_num, pxtnMEM_envelope ) ){ res = pxtnERR_memory; goto term; }
 			for( int32_t e = 0; e < pU->enve_num; e++ )
 			{
 				if( !_data_r_v( desc, &pU->enves[ e ].x ) ){ res = pxtnERR_desc_r; goto term; }
@@ -300,7 +300,7 @@ bool pxtnPulse_Noise::Allocate( int32_t unit_num, int32_t envelope_num )
 	{
 		pxNOISEDESIGN_UNIT *p_unit = &_units[ u ];
 		p_unit->enve_num = envelope_num;
-		if( !pxtnMem_zero_alloc( (void**)&p_unit->enves, sizeof(pxtnPOINT) * p_unit->enve_num ) ) goto End;
+		if( !pxtnMem_zero_alloc( (void**)&p_unit->enves, sizeof(pxtnPOINT) * p_unit->enve_num, pxtnMEM_envelope ) ) goto End;
 	}
 
 	b_ret = true;
@@ -332,7 +332,7 @@ bool pxtnPulse_Noise::copy_from( const pxtnPulse_Noise* src )
 			_units[ u ].main     = src->_units[ u ].main    ;
 			_units[ u ].pan      = src->_units[ u ].pan     ;
 			_units[ u ].volu     = src->_units[ u ].volu    ;
-			if( !( _units[ u ].enves = (pxtnPOINT*)malloc( sizeof(pxtnPOINT) * enve_num ) ) ) goto End;
+			if( !( _units[ u ].enves = (pxtnPOINT*)pxtnMem_alloc( sizeof(pxtnPOINT) * enve_num, pxtnMEM_envelope ) ) ) goto End;
 			for( int32_t e = 0; e < enve_num; e++ ) _units[ u ].enves[ e ] = src->_units[ u ].enves[ e ];
 		}
 	}
@@ -1,6 +1,7 @@
 
 #include "./pxtn.h"
 
+#include "./pxtnMax.h"
 #include "./pxtnMem.h"
 #include "./pxtnPulse_NoiseBuilder.h"
 
@@ -13,6 +14,8 @@
 #define _smp_num_rand    44100
 #define _smp_num         (int32_t)trunc( _BASIC_SPS / _BASIC_FREQUENCY )
 
+#define _BUILD_BLOCK       256
+
 
 enum _RANDOMTYPE
 {
@@ -106,6 +109,74 @@ void _incriment( _OSCILLATOR *p_osc, double incriment, const short *p_tbl_rand )
 	}
 }
 
+// one oscillator over a block. the three oscillators of a unit read their tables a little differently:
+// main skips negative offsets, freq scales the table to keys, volu reads it as is.
+enum _OSCREAD
+{
+	_OSCREAD_main = 0,
+	_OSCREAD_freq    ,
+	_OSCREAD_volu    ,
+};
+
+static void _oscillator_block( _OSCILLATOR *po, _OSCREAD read, double *p_dst, int32_t num, const double *p_incs, const short *p_tbl_rand )
+{
+	for( int32_t i = 0; i < num; i++ )
+	{
+		double  work   = 0;
+		int32_t offset = (int32_t)trunc( po->offset );
+
+		switch( po->ran_type )
+		{
+		case _RANDOM_None:
+			if     ( read == _OSCREAD_freq ) work = _KEY_TOP * po->p_smp[ offset ] / _SAMPLING_TOP;
+			else if( read == _OSCREAD_volu ) work = po->p_smp[ offset ];
+			else if( offset >= 0           ) work = po->p_smp[ offset ];
+			break;
+		case _RANDOM_Saw:
+			if( read != _OSCREAD_main || po->offset >= 0 ) work = po->rdm_start + po->rdm_margin * offset / _smp_num;
+			break;
+		case _RANDOM_Rect:
+			if( read != _OSCREAD_main || po->offset >= 0 ) work = po->rdm_start;
+			break;
+		}
+		if( po->bReverse ) work *= -1;
+		work *= po->volume;
+		p_dst[ i ] = work;
+
+		_incriment( po, p_incs ? p_incs[ i ] : po->incriment, p_tbl_rand );
+	}
+}
+
+static void _envelope_block( _UNIT *pU, double *p_dst, int32_t num )
+{
+	for( int32_t i = 0; i < num; i++ )
+	{
+		if( pU->enve_index < pU->enve_num )
+			p_dst[ i ] = pU->enve_mag_start + ( pU->enve_mag_margin * pU->enve_count / pU->enves[ pU->enve_index ].smp );
+		else 
+			p_dst[ i ] = pU->enve_mag_start;
+
+		if( pU->enve_index < pU->enve_num )
+		{
+			pU->enve_count++;
+			if( pU->enve_count >= pU->enves[ pU->enve_index ].smp )
+			{
+				pU->enve_count      = 0;
+				pU->enve_mag_start  = pU->enves[ pU->enve_index ].mag;
+				pU->enve_mag_margin = 0;
+				pU->enve_index++;
+				while( pU->enve_index < pU->enve_num )
+				{
+					pU->enve_mag_margin = pU->enves[ pU->enve_index ].mag - pU->enve_mag_start;
+					if( pU->enves[ pU->enve_index ].smp ) break;
+					pU->enve_mag_start  = pU->enves[ pU->enve_index ].mag;
+					pU->enve_index++;
+				}
+			}
+		}
+	}
+}
+
 pxtnPulse_NoiseBuilder::pxtnPulse_NoiseBuilder( pxtnIO_r io_read, pxtnIO_w io_write, pxtnIO_seek io_seek, pxtnIO_pos io_pos )
 {
 	_set_io_funcs( io_read, io_write, io_seek, io_pos );
@@ -214,13 +285,7 @@ bool pxtnPulse_NoiseBuilder::Init()
 
     // sine --
 	osci.ReadyGetSample( overtones_sine, 1, 128, _smp_num, 0 );
-	p = _p_tables[ pxWAVETYPE_Sine ];
-	for( s = 0; s < _smp_num; s++ )
-	{
-		work = osci.GetOneSample_Overtone( s ); if( work > 1.0 ) work = 1.0; if( work < -1.0 ) work = -1.0;
-		*p = (short)( work * _SAMPLING_TOP );
-		p++;
-	}
+	if( !osci.Render_Overtone( _p_tables[ pxWAVETYPE_Sine ], _smp_num, 1, NULL, NULL ) ) goto End;
 
 	// saw down --
 	p = _p_tables[ pxWAVETYPE_Saw ];
@@ -242,33 +307,15 @@ bool pxtnPulse_NoiseBuilder::Init()
 
     // saw2 --
 	osci.ReadyGetSample( overtones_saw2, 16, 128, _smp_num, 0 );
-	p = _p_tables[ pxWAVETYPE_Saw2 ];
-	for( s = 0; s < _smp_num; s++ )
-	{
-		work = osci.GetOneSample_Overtone( s ); if( work > 1.0 ) work = 1.0; if( work < -1.0 ) work = -1.0;
-		*p = (short)( work * _SAMPLING_TOP );
-		p++;
-	}
+	if( !osci.Render_Overtone( _p_tables[ pxWAVETYPE_Saw2 ], _smp_num, 1, NULL, NULL ) ) goto End;
 
     // rect2 --
 	osci.ReadyGetSample( overtones_rect2, 8, 128, _smp_num, 0 );
-	p = _p_tables[ pxWAVETYPE_Rect2 ];
-	for( s = 0; s < _smp_num; s++ )
-	{
-		work = osci.GetOneSample_Overtone( s ); if( work > 1.0 ) work = 1.0; if( work < -1.0 ) work = -1.0;
-		*p = (short)( work * _SAMPLING_TOP );
-		p++;
-	}
+	if( !osci.Render_Overtone( _p_tables[ pxWAVETYPE_Rect2 ], _smp_num, 1, NULL, NULL ) ) goto End;
 
 	// Triangle -- 
 	osci.ReadyGetSample( coodi_tri, 4, 128, _smp_num, _smp_num );	
-	p = _p_tables[ pxWAVETYPE_Tri ];
-	for( s = 0; s < _smp_num; s++ )
-	{
-		work = osci.GetOneSample_Coodinate( s ); if( work > 1.0 ) work = 1.0; if( work < -1.0 ) work = -1.0;
-		*p = (short)( work * _SAMPLING_TOP );
-		p++;
-	}
+	if( !osci.Render_Coodinate( _p_tables[ pxWAVETYPE_Tri ], _smp_num, 1, NULL, NULL ) ) goto End;
 
 	// Random2  -- x
 
@@ -333,11 +380,7 @@ pxtnPulse_PCM *pxtnPulse_NoiseBuilder::BuildNoise( pxtnPulse_Noise *p_noise, int
 	if( !_b_init ) return NULL;
 
 	bool           b_ret    = false;
-	int32_t        offset   =     0;
 	double         work     =     0;
-	double         vol      =     0;
-	double         fre      =     0;
-	double         store    =     0;
 	int32_t        byte4    =     0;
 	int32_t        unit_num =     0;
 	uint8_t*       p        = NULL ;
@@ -346,6 +389,12 @@ pxtnPulse_PCM *pxtnPulse_NoiseBuilder::BuildNoise( pxtnPulse_Noise *p_noise, int
 	_UNIT*         units    = NULL ;
 	pxtnPulse_PCM* p_pcm    = NULL ;
 
+	double         incs  [ _BUILD_BLOCK ];
+	double         vols  [ _BUILD_BLOCK ];
+	double         works [ _BUILD_BLOCK ];
+	double         enves [ _BUILD_BLOCK ];
+	double         stores[ _BUILD_BLOCK * pxtnMAX_CHANNEL ];
+
 	p_noise->Fix();
 
 	unit_num = p_noise->get_unit_num();
@@ -407,128 +456,64 @@ pxtnPulse_PCM *pxtnPulse_NoiseBuilder::BuildNoise( pxtnPulse_Noise *p_noise, int
 	if( p_pcm->Create( ch, sps, bps, smp_num ) != pxtnOK ) goto End;
 	p = (unsigned char*)p_pcm->get_p_buf_variable();
 
-	for( int32_t s = 0; s < smp_num; s++ )
+	// every unit is rendered on its own, one pass per stage, and added to 'store' in unit order.
+	for( int32_t s0 = 0; s0 < smp_num; s0 += _BUILD_BLOCK )
 	{
-		for( int32_t c = 0; c < ch; c++ )
-		{
-			store = 0;
-			for( int32_t u = 0; u < unit_num; u++ )
-			{
-				_UNIT *pU = &units[ u ];
-	
-				if( pU->bEnable )
-				{
-					_OSCILLATOR *po;
-
-					// main
-					po = &pU->main;
-					switch( po->ran_type )
-					{
-                    case _RANDOM_None:
-                        offset =            (int32_t)trunc(po->offset);
-						if( offset >= 0  ) work = po->p_smp[ offset ];
-						else               work = 0;
-						break;
-                    case _RANDOM_Saw:
-                        if( po->offset >= 0 ) work = po->rdm_start + po->rdm_margin * (int32_t)trunc(po->offset) / _smp_num;
-						else                  work = 0;
-						break;
-					case _RANDOM_Rect:
-						if( po->offset >= 0 ) work = po->rdm_start;
-						else                  work = 0;
-						break;
-					}
-					if( po->bReverse ) work *= -1;
-					work *= po->volume;
-					
-					// volu
-					po = &pU->volu;
-					switch( po->ran_type )
-					{
-					case _RANDOM_None:
-						offset = (int32_t   )po->offset;
-						vol    = (double)po->p_smp[ offset ];
-						break;
-                    case _RANDOM_Saw:
-                        vol = po->rdm_start + po->rdm_margin * (int32_t)trunc(po->offset) / _smp_num;
-						break;
-					case _RANDOM_Rect:
-						vol = po->rdm_start;
-						break;
-					}
-					if( po->bReverse ) vol *= -1;
-					vol *= po->volume;
-
-					work = work * ( vol + _SAMPLING_TOP ) / ( _SAMPLING_TOP * 2 );
-					work = work * pU->pan[ c ];
-
-					// envelope
-					if( pU->enve_index < pU->enve_num )
-						work *= pU->enve_mag_start + ( pU->enve_mag_margin * pU->enve_count / pU->enves[ pU->enve_index ].smp );
-					else 
-						work *= pU->enve_mag_start;
-					store += work;
-				}
-			}
+		int32_t num = smp_num - s0; if( num > _BUILD_BLOCK ) num = _BUILD_BLOCK;
 
-            byte4 = (int32_t)trunc(store);
-			if( byte4 >  _SAMPLING_TOP ) byte4 =  _SAMPLING_TOP;
-			if( byte4 < -_SAMPLING_TOP ) byte4 = -_SAMPLING_TOP;
-			if( bps ==  8 ){ *           p   = (unsigned char)( ( byte4 >> 8 ) + 128 ); p += 1; } //  8bit
-			else           { *( (short *)p ) = (short        )    byte4               ; p += 2; } // 16bit
-		}
+		for( int32_t i = 0; i < num * ch; i++ ) stores[ i ] = 0;
 
-		// incriment
 		for( int32_t u = 0; u < unit_num; u++ )
 		{
 			_UNIT *pU = &units[ u ];
 
-			if( pU->bEnable )
+			// a silent main adds only zeros.
+			if( !pU->bEnable || !pU->main.volume ) continue;
+
+			// freq -> main increments.
+			if( pU->freq.volume )
+			{
+				_oscillator_block( &pU->freq, _OSCREAD_freq, incs, num, NULL, _p_tables[ pxWAVETYPE_Random ] );
+				for( int32_t i = 0; i < num; i++ ) incs[ i ] = pU->main.incriment * _freq->Get( (int32_t)trunc( incs[ i ] ) );
+			}
+			else
 			{
-				_OSCILLATOR *po = &pU->freq;
+				double inc = pU->main.incriment * _freq->Get( 0 );
+				for( int32_t i = 0; i < num; i++ ) incs[ i ] = inc;
+			}
 
-				switch( po->ran_type )
-				{
-                case _RANDOM_None:
-                    offset = (int32_t)trunc(po->offset)    ;
-					fre = _KEY_TOP * po->p_smp[ offset ] / _SAMPLING_TOP;
-					break;
-                case _RANDOM_Saw:
-                    fre = po->rdm_start + po->rdm_margin * (int32_t) trunc(po->offset) / _smp_num;
-					break;
-				case _RANDOM_Rect:
-					fre = po->rdm_start;
-					break;
-				}
+			// volu.
+			if( pU->volu.volume ) _oscillator_block( &pU->volu, _OSCREAD_volu, vols, num, NULL, _p_tables[ pxWAVETYPE_Random ] );
+			else                  for( int32_t i = 0; i < num; i++ ) vols[ i ] = 0;
+
+			// main.
+			_oscillator_block( &pU->main, _OSCREAD_main, works, num, incs, _p_tables[ pxWAVETYPE_Random ] );
 
-				if( po->bReverse ) fre *= -1;
-				fre *= po->volume;
+			// envelope.
+			_envelope_block( pU, enves, num );
 
-                _incriment( &pU->main, pU->main.incriment * _freq->Get( (int32_t)trunc(fre) ), _p_tables[ pxWAVETYPE_Random ] );
-				_incriment( &pU->freq, pU->freq.incriment,                          _p_tables[ pxWAVETYPE_Random ] );
-				_incriment( &pU->volu, pU->volu.incriment,                          _p_tables[ pxWAVETYPE_Random ] );
+			for( int32_t i = 0; i < num; i++ ) works[ i ] = works[ i ] * ( vols[ i ] + _SAMPLING_TOP ) / ( _SAMPLING_TOP * 2 );
 
-				// envelope
-				if( pU->enve_index < pU->enve_num )
+			for( int32_t c = 0; c < ch; c++ )
+			{
+				double pan = pU->pan[ c ];
+				for( int32_t i = 0; i < num; i++ )
 				{
-					pU->enve_count++;
-					if( pU->enve_count >= pU->enves[ pU->enve_index ].smp )
-					{
-						pU->enve_count      = 0;
-						pU->enve_mag_start  = pU->enves[ pU->enve_index ].mag;
-						pU->enve_mag_margin = 0;
-						pU->enve_index++;
-						while( pU->enve_index < pU->enve_num )
-						{
-							pU->enve_mag_margin = pU->enves[ pU->enve_index ].mag - pU->enve_mag_start;
-							if( pU->enves[ pU->enve_index ].smp ) break;
-							pU->enve_mag_start  = pU->enves[ pU->enve_index ].mag;
-							pU->enve_index++;
-						}
-					}
+					work  = works[ i ] * pan;
+					work *= enves[ i ];
+					stores[ i * ch + c ] += work;
 				}
 			}
 		}
+
+		for( int32_t i = 0; i < num * ch; i++ )
+		{
+            byte4 = (int32_t)trunc( stores[ i ] );
+			if( byte4 >  _SAMPLING_TOP ) byte4 =  _SAMPLING_TOP;
+			if( byte4 < -_SAMPLING_TOP ) byte4 = -_SAMPLING_TOP;
+			if( bps ==  8 ){ *           p   = (unsigned char)( ( byte4 >> 8 ) + 128 ); p += 1; } //  8bit
+			else           { *( (short *)p ) = (short        )    byte4               ; p += 2; } // 16bit
+		}
 	}
 
 	b_ret = true;
@@ -6,6 +6,7 @@
 #include <vorbis/codec.h>
 #include <vorbis/vorbisfile.h>
 
+#include "./pxtnMem.h"
 #include "./pxtnPulse_Oggv.h"
 
 // OPNA2608 EDIT
@@ -152,8 +153,7 @@ pxtnPulse_Oggv::pxtnPulse_Oggv(pxtnIO_r io_read, pxtnIO_w io_write,
 pxtnPulse_Oggv::~pxtnPulse_Oggv() { Release(); }
 
 void pxtnPulse_Oggv::Release() {
-  if (_p_data) free(_p_data);
-  _p_data = NULL;
+  pxtnMem_free((void**)&_p_data);
   _ch = 0;
   _sps2 = 0;
   _smp_num = 0;
@@ -167,7 +167,7 @@ pxtnERR pxtnPulse_Oggv::ogg_read(void* desc) {
     res = pxtnERR_desc_r;
     goto term;
   }
-  if (!(_p_data = (char*)malloc(_size))) {
+  if (!(_p_data = (char*)pxtnMem_alloc(_size, pxtnMEM_oggv))) {
     res = pxtnERR_memory;
     goto term;
   }
@@ -181,8 +181,7 @@ pxtnERR pxtnPulse_Oggv::ogg_read(void* desc) {
 term:
 
   if (res != pxtnOK) {
-    if (_p_data) free(_p_data);
-    _p_data = NULL;
+    pxtnMem_free((void**)&_p_data);
     _size = 0;
   }
   return res;
@@ -307,15 +306,14 @@ bool pxtnPulse_Oggv::pxtn_read(void* desc) {
 
   if (!_size) goto End;
 
-  if (!(_p_data = (char*)malloc(_size))) goto End;
+  if (!(_p_data = (char*)pxtnMem_alloc(_size, pxtnMEM_oggv))) goto End;
   if (!_io_read(desc, _p_data, 1, _size)) goto End;
 
   b_ret = true;
 End:
 
   if (!b_ret) {
-    if (_p_data) free(_p_data);
-    _p_data = NULL;
+    pxtnMem_free((void**)&_p_data);
     _size = 0;
   }
 
@@ -328,7 +326,7 @@ bool pxtnPulse_Oggv::copy_from(const pxtnPulse_Oggv* src) {
   Release();
   if (!src->_p_data) return true;
 
-  if (!(_p_data = (char*)malloc(src->_size))) return false;
+  if (!(_p_data = (char*)pxtnMem_alloc(src->_size, pxtnMEM_oggv))) return false;
   memcpy(_p_data, src->_p_data, src->_size);
 
   _ch = src->_ch;
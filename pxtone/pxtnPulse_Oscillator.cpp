@@ -1,6 +1,10 @@
 ﻿
 #include "./pxtn.h"
 
+#include <float.h>
+
+#include "./pxtnMem.h"
+
 #include "./pxtnPulse_Oscillator.h"
 
 pxtnPulse_Oscillator::pxtnPulse_Oscillator( pxtnIO_r io_read, pxtnIO_w io_write, pxtnIO_seek io_seek, pxtnIO_pos io_pos )
@@ -86,4 +90,135 @@ double pxtnPulse_Oscillator::GetOneSample_Coodinate( int32_t index )
 
 	return work * _volume / 128 /128 ;
 
-}
\ No newline at end of file
+}
+
+static int16_t _Quantize( double osc, int32_t pan_volume, bool *pb_over )
+{
+	double work = osc * pan_volume / 64;
+	if( work >  1.0 ){ work =  1.0; *pb_over = true; }
+	if( work < -1.0 ){ work = -1.0; *pb_over = true; }
+	return (int16_t)(int32_t)( work * 32767 );
+}
+
+static void _Put( int16_t *p_dst, double osc, int32_t ch_num, const int32_t *pan_volume, bool *pb_over )
+{
+	for( int32_t c = 0; c < ch_num; c++ ) p_dst[ c ] = _Quantize( osc, pan_volume ? pan_volume[ c ] : 64, pb_over );
+}
+
+// sin( 2pi * x * index / num ) is taken from one table of 'num' entries (x * index wraps exactly).
+// the result differs from the sin() sum by less than 'err', so a sample is kept only when
+// osc - err and osc + err quantize the same; otherwise it is computed again the old way.
+bool pxtnPulse_Oscillator::Render_Overtone( int16_t *p_dst, int32_t smp_num, int32_t ch_num, const int32_t *pan_volume, bool *pb_over )
+{
+	bool    b_ret  = false;
+	double* p_sine = NULL ;
+	double  pi     = 3.1415926535897932;
+	double  err    = 0;
+	bool    b_dummy;
+
+	if( !pb_over ) pb_over = &b_dummy;
+
+	for( int32_t o = 0; o < _point_num; o++ )
+	{
+		if( _p_point[ o ].x <= 0 ) goto slow;
+		err += fabs( (double)_p_point[ o ].y ) / _p_point[ o ].x / 128 *
+			   ( 8 * DBL_EPSILON * ( 2 * pi * _p_point[ o ].x + 2 ) + ( 2 * _point_num + 12 ) * DBL_EPSILON );
+	}
+	err = err * 2 * ( _volume < 0 ? -_volume : _volume ) / 128 + DBL_MIN;
+
+	if( _sample_num <= 0 ) goto slow;
+	if( !pxtnMem_zero_alloc( (void**)&p_sine, sizeof(double) * _sample_num, pxtnMEM_voice ) ) goto End;
+	for( int32_t k = 0; k < _sample_num; k++ ) p_sine[ k ] = sin( 2 * pi * k / _sample_num );
+
+	for( int32_t s = 0; s < smp_num; s++, p_dst += ch_num )
+	{
+		double osc = 0;
+		for( int32_t o = 0; o < _point_num; o++ )
+		{
+			int32_t k = (int32_t)( (int64_t)_p_point[ o ].x * s % _sample_num );
+			osc += ( p_sine[ k ] * (double)_p_point[ o ].y / ( _p_point[ o ].x ) / 128 );
+		}
+		osc = osc * _volume / 128;
+
+		bool b_sure = true;
+		for( int32_t c = 0; c < ch_num; c++ )
+		{
+			int32_t pan   = pan_volume ? pan_volume[ c ] : 64;
+			bool    b_lo  = false, b_hi = false;
+			if( _Quantize( osc - err, pan, &b_lo ) != _Quantize( osc + err, pan, &b_hi ) || b_lo != b_hi ){ b_sure = false; break; }
+		}
+		if( !b_sure ) osc = GetOneSample_Overtone( s );
+		_Put( p_dst, osc, ch_num, pan_volume, pb_over );
+	}
+
+	b_ret = true;
+End:
+	pxtnMem_free( (void**)&p_sine );
+	return b_ret;
+
+slow:
+	for( int32_t s = 0; s < smp_num; s++, p_dst += ch_num ) _Put( p_dst, GetOneSample_Overtone( s ), ch_num, pan_volume, pb_over );
+	return true;
+}
+
+// same as GetOneSample_Coodinate, but the point search resumes from the previous sample.
+bool pxtnPulse_Oscillator::Render_Coodinate( int16_t *p_dst, int32_t smp_num, int32_t ch_num, const int32_t *pan_volume, bool *pb_over )
+{
+	int32_t  i, i_last;
+	int32_t  c;
+	int32_t  x1, y1, x2, y2;
+	int32_t  w, h;
+	double work;
+	bool   b_dummy;
+
+	if( !pb_over ) pb_over = &b_dummy;
+
+	if( _point_num <= 0 )
+	{
+		for( int32_t s = 0; s < smp_num; s++, p_dst += ch_num ) _Put( p_dst, GetOneSample_Coodinate( s ), ch_num, pan_volume, pb_over );
+		return true;
+	}
+
+	c      = 0;
+	i_last = 0;
+	for( int32_t s = 0; s < smp_num; s++, p_dst += ch_num )
+	{
+		i = _point_reso * s / _sample_num;
+
+		// first point beyond i only moves forward while i grows.
+		if( i < i_last ) c = 0;
+		i_last = i;
+		while( c < _point_num && _p_point[ c ].x <= i ) c++;
+
+		if( c == _point_num )
+		{
+			x1 = _p_point[ c - 1 ].x;
+			y1 = _p_point[ c - 1 ].y;
+			x2 = _point_reso;
+			y2 = _p_point[   0   ].y;
+		}
+		else if( c )
+		{
+			x1 = _p_point[ c - 1 ].x;
+			y1 = _p_point[ c - 1 ].y;
+			x2 = _p_point[   c   ].x;
+			y2 = _p_point[   c   ].y;
+		}
+		else
+		{
+			x1 = _p_point[   0   ].x;
+			y1 = _p_point[   0   ].y;
+			x2 = _p_point[   0   ].x;
+			y2 = _p_point[   0   ].y;
+		}
+
+		w = x2 - x1;
+		h = y2 - y1;
+
+		if( i - x1 ) work = (double)y1 + (double)h * (double)( i - x1 ) / (double)w;
+		else         work = y1;
+
+		_Put( p_dst, work * _volume / 128 /128, ch_num, pan_volume, pb_over );
+	}
+	return true;
+}
@@ -22,6 +22,11 @@ public:
 	void   ReadyGetSample( pxtnPOINT *p_point, int32_t point_num, int32_t volume, int32_t sample_num, int32_t point_reso );
 	double GetOneSample_Overtone ( int32_t index );
 	double GetOneSample_Coodinate( int32_t index );
+
+	// block versions: first smp_num samples as 16bit, ch_num interleaved.
+	// each channel is scaled by pan_volume[ ch ] / 64 (NULL = 64) and clipped like the callers of GetOneSample_*.
+	bool   Render_Overtone ( int16_t *p_dst, int32_t smp_num, int32_t ch_num, const int32_t *pan_volume, bool *pb_over );
+	bool   Render_Coodinate( int16_t *p_dst, int32_t smp_num, int32_t ch_num, const int32_t *pan_volume, bool *pb_over );
 };
 
 #endif
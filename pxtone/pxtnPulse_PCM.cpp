@@ -18,7 +18,7 @@ WAVEFORMATCHUNK;
 
 void pxtnPulse_PCM::Release()
 {
-	if( _p_smp ) free( _p_smp ); _p_smp = NULL;
+	pxtnMem_free( (void**)&_p_smp );
 	_ch       =    0;
 	_sps      =    0;
 	_bps      =    0;
@@ -66,7 +66,7 @@ pxtnERR pxtnPulse_PCM::Create( int32_t ch, int32_t sps, int32_t bps, int32_t sam
 	// bit / sample is 8 or 16
 	size = _smp_body * _bps * _ch / 8;
 
-	if( !( _p_smp = (uint8_t*)malloc( size ) ) ) return pxtnERR_memory;
+	if( !( _p_smp = (uint8_t*)pxtnMem_alloc( size, pxtnMEM_voice ) ) ) return pxtnERR_memory;
 
 	if( _bps == 8 ) memset( _p_smp, 128, size );
 	else            memset( _p_smp,   0, size );
@@ -129,7 +129,7 @@ pxtnERR pxtnPulse_PCM::read( void* desc )
 	res = pxtnOK;
 term:
 
-	if( res != pxtnOK && _p_smp ){ free( _p_smp ); _p_smp = NULL; }
+	if( res != pxtnOK ) pxtnMem_free( (void**)&_p_smp );
 	return res;
 }
 
@@ -247,7 +247,7 @@ bool pxtnPulse_PCM::_Convert_ChannelNum( int32_t new_ch )
 	if( new_ch == 2 )
 	{
 		work_size = sample_size * 2;
-		p_work     = (unsigned char *)malloc( work_size );
+		p_work     = (unsigned char *)pxtnMem_alloc( work_size, pxtnMEM_voice );
 		if( !p_work ) return false;
 
 		switch( _bps )
@@ -279,7 +279,7 @@ bool pxtnPulse_PCM::_Convert_ChannelNum( int32_t new_ch )
 	else
 	{
 		work_size = sample_size / 2;
-		p_work     = (unsigned char *)malloc( work_size );
+		p_work     = (unsigned char *)pxtnMem_alloc( work_size, pxtnMEM_voice );
 		if( !p_work ) return false;
 
 		switch( _bps )
@@ -307,12 +307,11 @@ bool pxtnPulse_PCM::_Convert_ChannelNum( int32_t new_ch )
 	}
 
 	// release once.
-	free( _p_smp );
-	_p_smp = NULL;
+	pxtnMem_free( (void**)&_p_smp );
 
-	if( !( _p_smp = (uint8_t*)malloc( work_size ) ) ){ free( p_work ); return false; }
+	if( !( _p_smp = (uint8_t*)pxtnMem_alloc( work_size, pxtnMEM_voice ) ) ){ pxtnMem_free( (void**)&p_work ); return false; }
 	memcpy( _p_smp, p_work, work_size );
-	free( p_work );
+	pxtnMem_free( (void**)&p_work );
 
 	// update param.
 	_ch = new_ch;
@@ -339,7 +338,7 @@ bool pxtnPulse_PCM::_Convert_BitPerSample( int32_t new_bps )
 	// 16 to 8 --------
 	case  8:
 		work_size = sample_size / 2;
-		p_work     = (uint8_t*)malloc( work_size );
+		p_work     = (uint8_t*)pxtnMem_alloc( work_size, pxtnMEM_voice );
 		if( !p_work ) return false;
 		b = 0;
 		for( a = 0; a < sample_size; a += 2 )
@@ -353,7 +352,7 @@ bool pxtnPulse_PCM::_Convert_BitPerSample( int32_t new_bps )
 	//  8 to 16 --------
 	case 16:
 		work_size = sample_size * 2;
-		p_work     = (uint8_t*)malloc( work_size );
+		p_work     = (uint8_t*)pxtnMem_alloc( work_size, pxtnMEM_voice );
 		if( !p_work ) return false;
 		b = 0;
 		for( a = 0; a < sample_size; a++ )
@@ -369,12 +368,11 @@ bool pxtnPulse_PCM::_Convert_BitPerSample( int32_t new_bps )
 	}
 
 	// release once.
-	free( _p_smp );
-	_p_smp = NULL;
+	pxtnMem_free( (void**)&_p_smp );
 
-	if( !( _p_smp = (uint8_t*)malloc( work_size ) ) ){ free( p_work ); return false; }
+	if( !( _p_smp = (uint8_t*)pxtnMem_alloc( work_size, pxtnMEM_voice ) ) ){ pxtnMem_free( (void**)&p_work ); return false; }
 	memcpy( _p_smp, p_work, work_size );
-	free( p_work );
+	pxtnMem_free( (void**)&p_work );
 
 	// update param.
 	_bps = new_bps;
@@ -424,7 +422,7 @@ bool pxtnPulse_PCM::_Convert_SamplePerSecond( int32_t new_sps )
 		sample_num  = work_size  / 4;
 		work_size   = sample_num * 4;
 		p4byte_data = (uint32_t *)_p_smp;
-		if( !pxtnMem_zero_alloc( (void **)&p4byte_work, work_size ) ) goto End;
+		if( !pxtnMem_zero_alloc( (void **)&p4byte_work, work_size, pxtnMEM_voice ) ) goto End;
 		for( a = 0; a < sample_num; a++ )
 		{
             b = (int32_t)trunc( (double)a * (double)(_sps) / (double)new_sps );
@@ -440,7 +438,7 @@ bool pxtnPulse_PCM::_Convert_SamplePerSecond( int32_t new_sps )
 		sample_num      = work_size  / 1;
 		work_size       = sample_num * 1;
 		p1byte_data     = (uint8_t*)_p_smp;
-		if( !pxtnMem_zero_alloc( (void **)&p1byte_work, work_size ) ) goto End;
+		if( !pxtnMem_zero_alloc( (void **)&p1byte_work, work_size, pxtnMEM_voice ) ) goto End;
 		for( a = 0; a < sample_num; a++ )
 		{
             b = (int32_t)trunc( (double)a * (double)(_sps) / (double)(new_sps) );
@@ -456,7 +454,7 @@ bool pxtnPulse_PCM::_Convert_SamplePerSecond( int32_t new_sps )
 		sample_num      = work_size  / 2;
 		work_size       = sample_num * 2;
 		p2byte_data     = (uint16_t*)_p_smp;
-		if( !pxtnMem_zero_alloc( (void**)&p2byte_work, work_size ) ) goto End;
+		if( !pxtnMem_zero_alloc( (void**)&p2byte_work, work_size, pxtnMEM_voice ) ) goto End;
 		for( a = 0; a < sample_num; a++ )
 		{
             b = (int32_t)trunc( (double)a * (double)(_sps) / (double)new_sps );
@@ -466,7 +464,7 @@ bool pxtnPulse_PCM::_Convert_SamplePerSecond( int32_t new_sps )
 
 	// release once.
 	pxtnMem_free( (void **)&_p_smp );
-	if( !pxtnMem_zero_alloc( (void **)&_p_smp, work_size ) ) goto End;
+	if( !pxtnMem_zero_alloc( (void **)&_p_smp, work_size, pxtnMEM_voice ) ) goto End;
 
 	if(      p4byte_work ) memcpy( _p_smp, p4byte_work, work_size );
 	else if( p2byte_work ) memcpy( _p_smp, p2byte_work, work_size );
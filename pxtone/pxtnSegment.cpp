@@ -0,0 +1,275 @@
+
+#include "./pxtnSegment.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./pxtn.h"
+#include "./pxtnMem.h"
+#include "./pxtnTrace.h"
+
+template <class T>
+using _MooVector = std::vector<T, pxtnMemAllocator<T, pxtnMEM_moo> >;
+
+// what every unit adds to its group over one range, from Moo_units().
+typedef struct {
+  int32_t* p_smps;       // [unit][frame][ch]
+  uint8_t* p_grps;       // [unit][frame]
+  int32_t** pp_units;    // into p_smps, one per unit.
+  uint8_t** pp_groups;   // into p_grps, one per unit.
+} _SEGMENTSLOT;
+
+typedef struct {
+  pxtnSegmentNewService new_service;
+  pxtnSegmentDeleteService delete_service;
+  void* user;
+  const pxtnVOMITPREPARATION* p_prep;
+  const uint8_t* p_mask;  // every unit.
+
+  const int32_t* bounds;  // first frame of each range, then the end.
+  int32_t seg_num;
+  _SEGMENTSLOT* slots;    // range s goes to slot s % slot_num.
+  int32_t slot_num;
+
+  std::atomic<int32_t> next;
+  std::atomic<int32_t> res;
+
+  // a range is rendered once its slot has been mixed out, and mixed once it
+  // is rendered.
+  std::mutex mtx;
+  std::condition_variable cond;
+  _MooVector<uint8_t> rendered;
+  int32_t mixed;
+} _SEGMENTJOB;
+
+static void _Fail(_SEGMENTJOB* p_job, pxtnERR err) {
+  int32_t ok = pxtnOK;
+  {
+    std::lock_guard<std::mutex> lock(p_job->mtx);
+    p_job->res.compare_exchange_strong(ok, err);
+  }
+  p_job->cond.notify_all();
+}
+
+static void _SlotRelease(_SEGMENTSLOT* p_slot) {
+  pxtnMem_free((void**)&p_slot->p_smps);
+  pxtnMem_free((void**)&p_slot->p_grps);
+  pxtnMem_free((void**)&p_slot->pp_units);
+  pxtnMem_free((void**)&p_slot->pp_groups);
+}
+
+static bool _SlotAllocate(_SEGMENTSLOT* p_slot, int32_t unit_num,
+                          int32_t ch_num, int32_t frame_num) {
+  memset(p_slot, 0, sizeof(_SEGMENTSLOT));
+  double smp_size = (double)sizeof(int32_t) * unit_num * frame_num * ch_num;
+  if (smp_size > 0x7fffffff) return false;
+
+  // a song without units still has one (empty) pointer to hand over.
+  int32_t ptr_num = unit_num ? unit_num : 1;
+  if (!pxtnMem_zero_alloc((void**)&p_slot->pp_units,
+                          sizeof(int32_t*) * ptr_num, pxtnMEM_moo) ||
+      !pxtnMem_zero_alloc((void**)&p_slot->pp_groups,
+                          sizeof(uint8_t*) * ptr_num, pxtnMEM_moo))
+    goto term;
+  if (!unit_num) return true;
+
+  if (!pxtnMem_zero_alloc((void**)&p_slot->p_smps, (uint32_t)smp_size,
+                          pxtnMEM_moo) ||
+      !pxtnMem_zero_alloc((void**)&p_slot->p_grps,
+                          (uint32_t)unit_num * frame_num, pxtnMEM_moo))
+    goto term;
+  for (int32_t u = 0; u < unit_num; u++) {
+    p_slot->pp_units[u] = &p_slot->p_smps[(size_t)u * frame_num * ch_num];
+    p_slot->pp_groups[u] = &p_slot->p_grps[(size_t)u * frame_num];
+  }
+  return true;
+term:
+  _SlotRelease(p_slot);
+  return false;
+}
+
+// renders the units of ranges until none are left. the service only moves
+// forward: the ranges other workers took are skipped.
+static void _Worker(_SEGMENTJOB* p_job) {
+  pxtnTRACE_THREAD("segment");
+  pxtnService* pxtn = p_job->new_service(p_job->user);
+  if (!pxtn) {
+    _Fail(p_job, pxtnERR_INIT);
+    return;
+  }
+
+  int32_t pos = -1;
+  while (p_job->res == pxtnOK) {
+    int32_t s = p_job->next++;
+    if (s >= p_job->seg_num) break;
+
+    int32_t start = p_job->bounds[s];
+    int32_t smp_num = p_job->bounds[s + 1] - start;
+    _SEGMENTSLOT* p_slot = &p_job->slots[s % p_job->slot_num];
+    {
+      std::unique_lock<std::mutex> lock(p_job->mtx);
+      p_job->cond.wait(lock, [p_job, s] {
+        return p_job->res != pxtnOK || s < p_job->mixed + p_job->slot_num;
+      });
+    }
+    if (p_job->res != pxtnOK) break;
+    pxtnTRACE_SCOPE("segment", s);
+
+    if (pos < 0) {
+      if (!pxtn->moo_preparation(p_job->p_prep)) {
+        _Fail(p_job, pxtnERR_moo_init);
+        break;
+      }
+      pos = 0;
+    }
+    {
+      pxtnTRACE_SCOPE("fast_forward", start - pos);
+      pxtn->moo_fast_forward(start - pos, false);
+    }
+    // fewer frames than asked for are only right past the end of the song.
+    if (pxtn->Moo_units(p_job->p_mask, p_slot->pp_units, p_slot->pp_groups,
+                        smp_num) != smp_num &&
+        !pxtn->moo_is_end_vomit()) {
+      _Fail(p_job, pxtn->moo_is_valid_data() ? pxtnERR_memory
+                                             : pxtnERR_moo_init);
+      break;
+    }
+    pos = start + smp_num;
+
+    {
+      std::lock_guard<std::mutex> lock(p_job->mtx);
+      p_job->rendered[s] = 1;
+    }
+    p_job->cond.notify_all();
+  }
+
+  p_job->delete_service(p_job->user, pxtn);
+}
+
+pxtnERR pxtnSegment_Render(pxtnSegmentNewService new_service,
+                           pxtnSegmentDeleteService delete_service, void* user,
+                           const pxtnVOMITPREPARATION* p_prep,
+                           const pxtnSEGMENTPARAM* p_param, void* p_buf,
+                           int32_t size) {
+  if (!new_service || !delete_service || !p_buf || size < 0)
+    return pxtnERR_param;
+
+  // the first service plans the ranges and then mixes them on this thread.
+  pxtnService* pxtn = new_service(user);
+  if (!pxtn) return pxtnERR_INIT;
+
+  pxtnERR res = pxtnERR_VOID;
+  int32_t ch_num = 0;
+  int32_t sps = 0;
+  pxtnDSTFORMAT format = pxtnDSTFORMAT_int16;
+  pxtn->get_destination_quality(&ch_num, &sps, &format);
+
+  int32_t frame_size = ch_num * (format == pxtnDSTFORMAT_int16 ? 2 : 4);
+  int32_t frame_num = frame_size ? size / frame_size : 0;
+  int32_t thread_num = p_param ? p_param->thread_num : 0;
+  int32_t segment_meas = p_param ? p_param->segment_meas : 0;
+  int32_t unit_num = pxtn->Unit_Num();
+  double smp_per_meas = 0;
+  int32_t meas_num = 0;
+  int32_t seg_num = 0;
+  int32_t seg_frame_max = 0;
+  int32_t slot_num = 0;
+  _MooVector<int32_t> bounds;
+  _MooVector<uint8_t> mask(unit_num ? unit_num : 1, 1);
+  _MooVector<_SEGMENTSLOT> slots;
+  _MooVector<std::thread> threads;
+  _SEGMENTJOB job;
+
+  if (!frame_size || size % frame_size || !pxtn->master->get_beat_tempo()) {
+    res = pxtnERR_param;
+    goto term;
+  }
+
+  if (thread_num <= 0) thread_num = (int32_t)std::thread::hardware_concurrency();
+  if (thread_num <= 0) thread_num = 1;
+  if (segment_meas <= 0) segment_meas = 1;
+
+  smp_per_meas = (double)sps * 60 * pxtn->master->get_beat_num() /
+                 pxtn->master->get_beat_tempo();
+  while ((int32_t)trunc(meas_num * smp_per_meas) < frame_num) meas_num++;
+
+  seg_num = (meas_num + segment_meas - 1) / segment_meas;
+  for (int32_t s = 0; s <= seg_num; s++) {
+    int32_t b = (int32_t)trunc((double)s * segment_meas * smp_per_meas);
+    bounds.push_back(b < frame_num ? b : frame_num);
+    if (s && bounds[s] - bounds[s - 1] > seg_frame_max)
+      seg_frame_max = bounds[s] - bounds[s - 1];
+  }
+  if (thread_num > seg_num) thread_num = seg_num;
+
+  slot_num = thread_num + 1;
+  if (slot_num > seg_num) slot_num = seg_num;
+  slots.resize(slot_num);
+  for (int32_t i = 0; i < slot_num; i++) {
+    if (!_SlotAllocate(&slots[i], unit_num, ch_num, seg_frame_max)) {
+      slot_num = i;
+      res = pxtnERR_memory;
+      goto term;
+    }
+  }
+
+  if (!pxtn->moo_preparation(p_prep)) {
+    res = pxtnERR_moo_init;
+    goto term;
+  }
+
+  job.new_service = new_service;
+  job.delete_service = delete_service;
+  job.user = user;
+  job.p_prep = p_prep;
+  job.p_mask = mask.data();
+  job.bounds = bounds.data();
+  job.seg_num = seg_num;
+  job.slots = slots.data();
+  job.slot_num = slot_num;
+  job.next = 0;
+  job.res = pxtnOK;
+  job.rendered.assign(seg_num, 0);
+  job.mixed = 0;
+
+  for (int32_t t = 0; t < thread_num; t++)
+    threads.emplace_back(_Worker, &job);
+
+  for (int32_t s = 0; s < seg_num; s++) {
+    {
+      std::unique_lock<std::mutex> lock(job.mtx);
+      job.cond.wait(lock,
+                    [&job, s] { return job.res != pxtnOK || job.rendered[s]; });
+    }
+    if (job.res != pxtnOK) break;
+
+    const _SEGMENTSLOT* p_slot = &slots[s % slot_num];
+    uint8_t* p = (uint8_t*)p_buf + (size_t)bounds[s] * frame_size;
+    int32_t smp_num = bounds[s + 1] - bounds[s];
+    int32_t mixed = 0;
+    {
+      pxtnTRACE_SCOPE("mix", s);
+      mixed = pxtn->Moo_mix_units(p_slot->pp_units, p_slot->pp_groups, p,
+                                  smp_num);
+    }
+    if (mixed != smp_num && !pxtn->moo_is_end_vomit()) {
+      _Fail(&job, pxtnERR_moo_init);
+      break;
+    }
+    {
+      std::lock_guard<std::mutex> lock(job.mtx);
+      job.mixed = s + 1;
+    }
+    job.cond.notify_all();
+  }
+  for (auto& t : threads) t.join();
+
+  res = (pxtnERR)job.res.load();
+term:
+  for (int32_t i = 0; i < slot_num; i++) _SlotRelease(&slots[i]);
+  delete_service(user, pxtn);
+  return res;
+}
@@ -0,0 +1,32 @@
+#ifndef pxtnSegment_H
+#define pxtnSegment_H
+
+#include "./pxtnService.h"
+
+// one song rendered on several threads. the output is cut into measure
+// ranges; each worker takes a range, fast-forwards its own service to it and
+// renders what every unit adds to its group there (Moo_units()). the calling
+// thread mixes the ranges in order through one service (Moo_mix_units()), so
+// the delays and the fade run on unbroken from range to range.
+
+// returns a service that is read, tones_ready and has the destination
+// quality of the output. called from the worker threads.
+typedef pxtnService* (*pxtnSegmentNewService)(void* user);
+typedef void (*pxtnSegmentDeleteService)(void* user, pxtnService* pxtn);
+
+typedef struct {
+  int32_t thread_num;    // workers; 0: one per hardware thread.
+  int32_t segment_meas;  // measures per range; 0: one.
+} pxtnSEGMENTPARAM;
+
+// fills 'size' bytes of p_buf as Moo() from moo_preparation(p_prep) would,
+// sample for sample. frames after the end of the song are zeroed. p_param
+// may be NULL for the defaults. the unit output of thread_num + 1 ranges is
+// held at a time. a range that cannot be rendered or mixed fails the call.
+pxtnERR pxtnSegment_Render(pxtnSegmentNewService new_service,
+                           pxtnSegmentDeleteService delete_service, void* user,
+                           const pxtnVOMITPREPARATION* p_prep,
+                           const pxtnSEGMENTPARAM* p_param, void* p_buf,
+                           int32_t size);
+
+#endif
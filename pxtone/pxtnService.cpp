@@ -9,6 +9,8 @@
 #include "./pxtnService.h"
 
 #include "./pxtn.h"
+#include "./pxtnMem.h"
+#include "./pxtnTrace.h"
 
 #define _VERSIONSIZE 16
 #define _CODESIZE 8
@@ -89,6 +91,8 @@ pxtnService::pxtnService(pxtnIO_r io_read, pxtnIO_w io_write,
   _b_init = false;
   _b_edit = false;
   _b_fix_evels_num = false;
+  _b_env_table = false;
+  _dst_format = pxtnDSTFORMAT_int16;
 
   text = NULL;
   master = NULL;
@@ -107,6 +111,8 @@ pxtnService::pxtnService(pxtnIO_r io_read, pxtnIO_w io_write,
 
   _sampled_proc = NULL;
   _sampled_user = NULL;
+  _stage_proc = NULL;
+  _stage_user = NULL;
 
   _moo_constructor();
 }
@@ -123,23 +129,19 @@ bool pxtnService::_release() {
   SAFE_DELETE(_ptn_bldr);
   if (_delays) {
     for (int32_t i = 0; i < _delay_num; i++) SAFE_DELETE(_delays[i]);
-    free(_delays);
-    _delays = NULL;
+    pxtnMem_free((void**)&_delays);
   }
   if (_ovdrvs) {
     for (int32_t i = 0; i < _ovdrv_num; i++) SAFE_DELETE(_ovdrvs[i]);
-    free(_ovdrvs);
-    _ovdrvs = NULL;
+    pxtnMem_free((void**)&_ovdrvs);
   }
   if (_woices) {
     for (int32_t i = 0; i < _woice_num; i++) SAFE_DELETE(_woices[i]);
-    free(_woices);
-    _woices = NULL;
+    pxtnMem_free((void**)&_woices);
   }
   if (_units) {
     for (int32_t i = 0; i < _unit_num; i++) SAFE_DELETE(_units[i]);
-    free(_units);
-    _units = NULL;
+    pxtnMem_free((void**)&_units);
   }
   return true;
 }
@@ -190,38 +192,34 @@ pxtnERR pxtnService::_init(int32_t fix_evels_num, bool b_edit) {
 
   // delay
   byte_size = sizeof(pxtnDelay*) * pxtnMAX_TUNEDELAYSTRUCT;
-  if (!(_delays = (pxtnDelay**)malloc(byte_size))) {
+  if (!pxtnMem_zero_alloc((void**)&_delays, byte_size)) {
     res = pxtnERR_memory;
     goto End;
   }
-  memset(_delays, 0, byte_size);
   _delay_max = pxtnMAX_TUNEDELAYSTRUCT;
 
   // over-drive
   byte_size = sizeof(pxtnOverDrive*) * pxtnMAX_TUNEOVERDRIVESTRUCT;
-  if (!(_ovdrvs = (pxtnOverDrive**)malloc(byte_size))) {
+  if (!pxtnMem_zero_alloc((void**)&_ovdrvs, byte_size)) {
     res = pxtnERR_memory;
     goto End;
   }
-  memset(_ovdrvs, 0, byte_size);
   _ovdrv_max = pxtnMAX_TUNEOVERDRIVESTRUCT;
 
   // woice
   byte_size = sizeof(pxtnWoice*) * pxtnMAX_TUNEWOICESTRUCT;
-  if (!(_woices = (pxtnWoice**)malloc(byte_size))) {
+  if (!pxtnMem_zero_alloc((void**)&_woices, byte_size)) {
     res = pxtnERR_memory;
     goto End;
   }
-  memset(_woices, 0, byte_size);
   _woice_max = pxtnMAX_TUNEWOICESTRUCT;
 
   // unit
   byte_size = sizeof(pxtnUnit*) * pxtnMAX_TUNEUNITSTRUCT;
-  if (!(_units = (pxtnUnit**)malloc(byte_size))) {
+  if (!pxtnMem_zero_alloc((void**)&_units, byte_size)) {
     res = pxtnERR_memory;
     goto End;
   }
-  memset(_units, 0, byte_size);
   _unit_max = pxtnMAX_TUNEUNITSTRUCT;
 
   _group_num = pxtnMAX_TUNEGROUPNUM;
@@ -257,14 +255,22 @@ pxtnERR pxtnService::tones_ready() {
   float beat_tempo = master->get_beat_tempo();
 
   for (int32_t i = 0; i < _delay_num; i++) {
+    pxtnTRACE_SCOPE("delay_ready", i);
+    _Stage(pxtnSTAGE_delay_ready, i, false);
     res = _delays[i]->Tone_Ready(beat_num, beat_tempo, _dst_sps);
+    _Stage(pxtnSTAGE_delay_ready, i, true);
     if (res != pxtnOK) return res;
   }
   for (int32_t i = 0; i < _ovdrv_num; i++) {
+    _Stage(pxtnSTAGE_overdrive_ready, i, false);
     _ovdrvs[i]->Tone_Ready();
+    _Stage(pxtnSTAGE_overdrive_ready, i, true);
   }
   for (int32_t i = 0; i < _woice_num; i++) {
-    res = _woices[i]->Tone_Ready(_ptn_bldr, _dst_sps);
+    pxtnTRACE_SCOPE("woice_ready", i);
+    _Stage(pxtnSTAGE_woice_ready, i, false);
+    res = _woices[i]->Tone_Ready(_ptn_bldr, _dst_sps, _b_env_table);
+    _Stage(pxtnSTAGE_woice_ready, i, true);
     if (res != pxtnOK) return res;
   }
   return pxtnOK;
@@ -414,7 +420,7 @@ pxtnERR pxtnService::Woice_read(int32_t idx, void* desc, pxtnWOICETYPE type) {
 pxtnERR pxtnService::Woice_ReadyTone(int32_t idx) {
   if (!_b_init) return pxtnERR_INIT;
   if (idx < 0 || idx >= _woice_num) return pxtnERR_param;
-  return _woices[idx]->Tone_Ready(_ptn_bldr, _dst_sps);
+  return _woices[idx]->Tone_Ready(_ptn_bldr, _dst_sps, _b_env_table);
 }
 
 bool pxtnService::Woice_Remove(int32_t idx) {
@@ -472,6 +478,7 @@ bool pxtnService::Unit_AddNew() {
   if (_unit_num >= _unit_max) return false;
   _units[_unit_num] = new pxtnUnit(_io_read, _io_write, _io_seek, _io_pos);
   _unit_num++;
+  _moo_ActivateAllUnits();
   return true;
 }
 
@@ -482,6 +489,7 @@ bool pxtnService::Unit_Remove(int32_t idx) {
   _unit_num--;
   for (int32_t i = idx; i < _unit_num; i++) _units[i] = _units[i + 1];
   _units[_unit_num] = NULL;
+  _moo_ActivateAllUnits();
   return true;
 }
 
@@ -531,7 +539,8 @@ bool pxtnService::Unit_Solo(int idx) {
 // Quality..
 // ---------------------------
 
-bool pxtnService::set_destination_quality(int32_t ch_num, int32_t sps) {
+bool pxtnService::set_destination_quality(int32_t ch_num, int32_t sps,
+                                          pxtnDSTFORMAT format) {
   if (!_b_init) return false;
   switch (ch_num) {
     case 1:
@@ -542,17 +551,44 @@ bool pxtnService::set_destination_quality(int32_t ch_num, int32_t sps) {
       return false;
   }
 
+  int32_t byte_per_smp = 0;
+  switch (format) {
+    case pxtnDSTFORMAT_int16:
+      byte_per_smp = pxtnBITPERSAMPLE / 8;
+      break;
+    case pxtnDSTFORMAT_int32:
+      byte_per_smp = sizeof(int32_t);
+      break;
+    case pxtnDSTFORMAT_float32:
+      byte_per_smp = sizeof(float);
+      break;
+    default:
+      return false;
+  }
+
   _dst_ch_num = ch_num;
   _dst_sps = sps;
-  _dst_byte_per_smp = pxtnBITPERSAMPLE / 8 * ch_num;
+  _dst_format = format;
+  _dst_byte_per_smp = byte_per_smp * ch_num;
   return true;
 }
 
-bool pxtnService::get_destination_quality(int32_t* p_ch_num,
-                                          int32_t* p_sps) const {
+bool pxtnService::get_destination_quality(int32_t* p_ch_num, int32_t* p_sps,
+                                          pxtnDSTFORMAT* p_format) const {
   if (!_b_init) return false;
   if (p_ch_num) *p_ch_num = _dst_ch_num;
   if (p_sps) *p_sps = _dst_sps;
+  if (p_format) *p_format = _dst_format;
+  return true;
+}
+
+bool pxtnService::set_envelope_table(bool b) {
+  if (!_b_init) return false;
+  _b_env_table = b;
+  for (int32_t i = 0; i < _woice_num; i++) {
+    if (_woices[i]->Tone_Ready_envelope(_dst_sps, _b_env_table) != pxtnOK)
+      return false;
+  }
   return true;
 }
 
@@ -563,6 +599,17 @@ bool pxtnService::set_sampled_callback(pxtnSampledCallback proc, void* user) {
   return true;
 }
 
+bool pxtnService::set_stage_callback(pxtnStageCallback proc, void* user) {
+  if (!_b_init) return false;
+  _stage_proc = proc;
+  _stage_user = user;
+  return true;
+}
+
+void pxtnService::_Stage(pxtnSTAGE stage, int32_t index, bool b_end) const {
+  if (_stage_proc) _stage_proc(_stage_user, this, stage, index, b_end);
+}
+
 static _enum_Tag _CheckTagCode(const char* p_code) {
   if (!memcmp(p_code, _code_antiOPER, _CODESIZE))
     return _TAG_antiOPER;
@@ -1491,6 +1538,7 @@ term:
 
 pxtnERR pxtnService::read(void* desc) {
   if (!_b_init) return pxtnERR_INIT;
+  pxtnTRACE_SCOPE("read", -1);
 
   pxtnERR res = pxtnERR_VOID;
   uint16_t exe_ver = 0;
@@ -1499,7 +1547,12 @@ pxtnERR pxtnService::read(void* desc) {
 
   clear();
 
-  res = _pre_count_event(desc, &event_num);
+  {
+    pxtnTRACE_SCOPE("pre_count_event", -1);
+    _Stage(pxtnSTAGE_pre_count_event, 0, false);
+    res = _pre_count_event(desc, &event_num);
+    _Stage(pxtnSTAGE_pre_count_event, 0, true);
+  }
   if (res != pxtnOK) goto term;
   _io_seek(desc, SEEK_SET, 0);
 
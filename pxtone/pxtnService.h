@@ -16,6 +16,36 @@
 
 #define pxtnVOMITPREPFLAG_loop 0x01
 #define pxtnVOMITPREPFLAG_unit_mute 0x02
+#define pxtnVOMITPREPFLAG_fixed_phase 0x04  // 32.32 voice position
+#define pxtnVOMITPREPFLAG_fast_forward 0x08  // reach the start by moo_fast_forward
+
+// sample format written by Moo().
+enum pxtnDSTFORMAT {
+  pxtnDSTFORMAT_int16 = 0,  // clipped to 16 bit.
+  pxtnDSTFORMAT_int32,      // 16 bit scaled by 65536; carries a 24-bit file.
+  pxtnDSTFORMAT_float32,    // 1.0f = 16-bit full scale, not clipped.
+};
+
+// streams written by Moo_stems().
+enum pxtnSTEMMODE {
+  pxtnSTEM_unit = 0,  // each unit, before the effects of its group.
+  pxtnSTEM_group,     // each group, after its overdrives and delays.
+};
+
+// what moo_get_profile() reports on.
+enum pxtnPROFILEKIND {
+  pxtnPROFILE_unit = 0,
+  pxtnPROFILE_woice,  // through the units playing it, by block.
+  pxtnPROFILE_delay,
+  pxtnPROFILE_overdrive,
+};
+
+// render cost of one unit, woice or effect while profiling.
+typedef struct {
+  int64_t tick_num;  // moo_get_profile_tick_sec() each.
+  int64_t event_num;
+  int64_t frame_num;  // frames sampled (units, woices) or processed (effects).
+} pxtnPROFILECOST;
 
 typedef struct {
   int32_t start_pos_meas;
@@ -34,6 +64,18 @@ class pxtnService;
 
 typedef bool (*pxtnSampledCallback)(void* user, const pxtnService* pxtn);
 
+// steps of read() and tones_ready(), reported to the stage callback once
+// before (b_end false) and once after each.
+enum pxtnSTAGE {
+  pxtnSTAGE_pre_count_event = 0,  // read() counting the events.
+  pxtnSTAGE_delay_ready,          // index: delay.
+  pxtnSTAGE_overdrive_ready,      // index: overdrive.
+  pxtnSTAGE_woice_ready,          // index: woice.
+};
+
+typedef void (*pxtnStageCallback)(void* user, const pxtnService* pxtn,
+                                  pxtnSTAGE stage, int32_t index, bool b_end);
+
 class pxtnService : public pxtnData {
  private:
   void operator=(const pxtnService& src) {}
@@ -51,8 +93,10 @@ class pxtnService : public pxtnData {
   bool _b_init;
   bool _b_edit;
   bool _b_fix_evels_num;
+  bool _b_env_table;
 
   int32_t _dst_ch_num, _dst_sps, _dst_byte_per_smp;
+  pxtnDSTFORMAT _dst_format;
 
   pxtnPulse_NoiseBuilder* _ptn_bldr;
 
@@ -102,6 +146,7 @@ class pxtnService : public pxtnData {
 
   bool _moo_b_mute_by_unit;
   bool _moo_b_loop;
+  bool _moo_b_fixed_phase;
 
   int32_t _moo_smp_smooth;
   float _moo_clock_rate;  // as the sample
@@ -126,9 +171,33 @@ class pxtnService : public pxtnData {
   int32_t _moo_bt_num;
 
   int32_t* _moo_group_smps;
+  int32_t* _moo_group_blks;  // [ch][group][_MOO_BLOCK], read by the effects.
+  int32_t* _moo_fade_blks;   // fade gain per frame of the block, -1: none.
+  int32_t* _moo_stem_blks;   // [unit][ch][_MOO_BLOCK], on first Moo_stems().
+  uint8_t* _moo_stem_grps;   // [unit][_MOO_BLOCK], the group of each frame.
+  bool _moo_b_stem_units;    // units write _moo_stem_blks and _moo_stem_grps.
+  int32_t* _moo_stem_units;  // [_unit_max], the units written there.
+  int32_t _moo_stem_num;
+  const uint8_t* _moo_unit_mask;  // units rendered by Moo_units(), else NULL.
+
+  // moo_set_profile(): [units][woices][delays][overdrives], each of its max.
+  bool _moo_b_profile;
+  pxtnPROFILECOST* _moo_prof_costs;
+  int64_t _moo_prof_tick0;
+  int64_t _moo_prof_ns0;
+  int64_t _moo_prof_tick_null;  // ticks read back to back, taken off each unit.
+
+  // units that may still make sound; the rest are skipped per sample.
+  pxtnUnit** _moo_active_units;
+  int32_t _moo_active_num;
 
   const EVERECORD* _moo_p_eve;
 
+  // render snapshots for moo_seek(), _moo_snap_size bytes each.
+  uint8_t* _moo_snaps;
+  int32_t _moo_snap_num;
+  int32_t _moo_snap_size;
+
   pxtnPulse_Frequency* _moo_freq;
 
   pxtnERR _init(int32_t fix_evels_num, bool b_edit);
@@ -142,10 +211,36 @@ class pxtnService : public pxtnData {
 
   bool _moo_ResetVoiceOn(pxtnUnit* p_u, int32_t w) const;
   bool _moo_InitUnitTone();
-  bool _moo_PXTONE_SAMPLE(void* p_data);
+  void _moo_ActivateUnit(pxtnUnit* p_u);
+  void _moo_ActivateAllUnits();
+  void _moo_PXTONE_EVENTS();
+  bool _moo_PXTONE_TONES(int32_t blk_pos);
+  bool _moo_PXTONE_NEXT();
+  bool _moo_PXTONE_COUNT();
+  int32_t _moo_PXTONE_BLOCK(int32_t num, bool* pb_end);
+  void _moo_PXTONE_EFFECTS(int32_t num);
+  void _moo_PXTONE_MIX(void* p_dst, int32_t num);
+  void _moo_PXTONE_OUT(void* p_dst, int32_t ch, const int32_t* p_src,
+                       int32_t num) const;
+  void _moo_PXTONE_MIX_planar(float* const* pp_dst, int32_t pos, int32_t num);
+  int32_t _moo_Advance(int32_t smp_num);
+  int32_t _moo_EventSample(int32_t clock) const;
+  void _moo_CompactActiveUnits();
+  int32_t _moo_Skip(int32_t smp_num, int32_t* p_quiet, int32_t quiet_num);
+  int32_t _moo_FastForward(int32_t smp_num, bool b_delays, int32_t* p_quiet);
+  bool _moo_AllocStems();
+  void _moo_FindEvent();
+  pxtnPROFILECOST* _moo_ProfileCost(pxtnPROFILEKIND kind, int32_t idx) const;
+  int64_t _moo_ProfileUnit(int32_t a, int64_t tick, int32_t frame_num);
+  int64_t _moo_ProfileEffect(pxtnPROFILEKIND kind, int32_t idx, int64_t tick);
+  void _moo_ProfileEvent(int32_t u, int64_t tick);
+  void _moo_ProfileBlock();
 
   pxtnSampledCallback _sampled_proc;
   void* _sampled_user;
+  pxtnStageCallback _stage_proc;
+  void* _stage_user;
+  void _Stage(pxtnSTAGE stage, int32_t index, bool b_end) const;
 
  public:
   pxtnService(pxtnIO_r io_read, pxtnIO_w io_write, pxtnIO_seek io_seek,
@@ -215,9 +310,15 @@ class pxtnService : public pxtnData {
   bool Unit_Solo(int32_t idx);
 
   // q
-  bool set_destination_quality(int32_t ch_num, int32_t sps);
-  bool get_destination_quality(int32_t* p_ch_num, int32_t* p_sps) const;
+  bool set_destination_quality(int32_t ch_num, int32_t sps,
+                               pxtnDSTFORMAT format = pxtnDSTFORMAT_int16);
+  bool get_destination_quality(int32_t* p_ch_num, int32_t* p_sps,
+                               pxtnDSTFORMAT* p_format = NULL) const;
+  // envelopes are stepped per segment unless the old per-sample table is
+  // requested (more memory, same output).
+  bool set_envelope_table(bool b);
   bool set_sampled_callback(pxtnSampledCallback proc, void* user);
+  bool set_stage_callback(pxtnStageCallback proc, void* user);
 
   //////////////
   // Moo..
@@ -228,6 +329,7 @@ class pxtnService : public pxtnData {
 
   bool moo_set_mute_by_unit(bool b);
   bool moo_set_loop(bool b);
+  bool moo_set_fixed_phase(bool b);
   bool moo_set_fade(int32_t fade, float sec);
   bool moo_set_master_volume(float v);
 
@@ -237,10 +339,81 @@ class pxtnService : public pxtnData {
   int32_t moo_get_end_clock() const;
   int32_t moo_get_sampling_offset() const;
   int32_t moo_get_sampling_end() const;
+  int32_t moo_get_sampling_repeat() const;
 
   bool moo_preparation(const pxtnVOMITPREPARATION* p_build);
 
+  // whole render state (units, delays, fade, event cursor) as a blob, valid
+  // for this service until the song or its tones change.
+  int32_t moo_state_size() const;
+  bool moo_state_save(void* p_buf, int32_t size) const;
+  bool moo_state_load(const void* p_buf, int32_t size);
+  // true if both states render the same from here on. field by field: the
+  // rings are compared from their own positions, and padding and what a
+  // voice out of life left behind are ignored.
+  bool moo_state_same(const void* p_buf1, const void* p_buf2,
+                      int32_t size) const;
+
+  // walks the song by moo_fast_forward(), keeping the state every
+  // 'meas_interval' measures: only the time-pan rings before each state and
+  // the frames the delays could still hold are rendered, so a song whose
+  // delays never fall quiet costs a render without the mix. moo_seek() then
+  // restores the nearest state and renders forward to the sample, keeping the
+  // fade of the current preparation. use the same meas_end / flags for the
+  // build and for playback.
+  pxtnERR moo_snapshot_build(const pxtnVOMITPREPARATION* p_prep,
+                             int32_t meas_interval);
+  void moo_snapshot_release();
+  bool moo_seek(int32_t smp_pos);
+  // after the events from clock1 to clock2 were edited (old and new places):
+  // renders again only what they can change, over p_buf, which holds the
+  // whole render of the snapshot preparation from its start without fade-in.
+  // it runs from the snapshot before the first note the edit can reach to
+  // the first snapshot after clock2 whose state is unchanged; those frames
+  // are returned as [*p_smp1, *p_smp2). the snapshots follow the edit.
+  pxtnERR moo_render_range(int32_t clock1, int32_t clock2, void* p_buf,
+                           int32_t size, int32_t* p_smp1, int32_t* p_smp2);
+
+  // advances without sampling or mixing to the same state a render reaches.
+  // the time-pan rings and the delays are rendered: the delays from the last
+  // point where no unit had fed them long enough for them to decay to zero,
+  // else from here. without 'b_delays' they are cleared instead, for a
+  // service that only renders Moo_units(). returns the samples advanced.
+  int32_t moo_fast_forward(int32_t smp_num, bool b_delays = true);
+
+  // while on, counts what each unit, woice and effect costs the render
+  // (units are timed on every 16th frame); turning it on clears the counts,
+  // off drops them. ticks are cpu cycles where they are cheap to read, else
+  // ns.
+  bool moo_set_profile(bool b);
+  bool moo_get_profile(pxtnPROFILEKIND kind, int32_t idx,
+                       pxtnPROFILECOST* p_cost) const;
+  // seconds per tick, measured over the profile so far.
+  double moo_get_profile_tick_sec() const;
+
   int32_t Moo(void* p_buf, int32_t size, int32_t* filled_size);
+  // one float buffer per destination channel, 1.0f = 16-bit full scale.
+  // returns the frames rendered; safe for a real-time audio thread.
+  int32_t Moo_planar(float* const* channels, int32_t frames);
+
+  // every unit or group mixed like Moo() into its own buffer in one pass,
+  // and the full mix into p_mix unless it is NULL. returns the frames
+  // rendered; frames after the end of the song are zeroed.
+  int32_t moo_stem_num(pxtnSTEMMODE mode) const;
+  int32_t Moo_stems(pxtnSTEMMODE mode, void* const* p_stems, void* p_mix,
+                    int32_t frames);
+
+  // what the units with p_mask[u] set add to their groups, before effects,
+  // fade and master volume: 'frames' frames of interleaved channels into
+  // p_units[u] and the group of each frame into p_groups[u]. the other units
+  // are not rendered; keep the mask until the next moo_preparation().
+  int32_t Moo_units(const uint8_t* p_mask, int32_t* const* p_units,
+                    uint8_t* const* p_groups, int32_t frames);
+  // Moo() from the output of Moo_units() for every unit (NULL: silent),
+  // through the effects, fade and master volume of this preparation.
+  int32_t Moo_mix_units(const int32_t* const* p_units,
+                        const uint8_t* const* p_groups, void* p_buf,
+                        int32_t frames);
 };
 
 int32_t pxtnService_moo_CalcSampleNum(int32_t meas_num, int32_t beat_num,
@@ -2,6 +2,34 @@
 #include "./pxtn.h"
 #include "./pxtnMem.h"
 #include "./pxtnService.h"
+#include "./pxtnTrace.h"
+
+#include <chrono>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define _MOO_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define _MOO_RDTSC
+#endif
+
+#define _MOO_BLOCK 256  // frames rendered by the units before effects and mix.
+#define _MOO_PROFILE_STRIDE 16  // units are timed on one frame in this many.
+
+static int64_t _moo_Ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// profile ticks: cpu cycles where they are cheap to read, else ns.
+static inline int64_t _moo_Tick() {
+#ifdef _MOO_RDTSC
+  return (int64_t)__rdtsc();
+#else
+  return _moo_Ns();
+#endif
+}
 
 void pxtnService::_moo_constructor() {
   _moo_b_init = false;
@@ -10,6 +38,7 @@ void pxtnService::_moo_constructor() {
   _moo_b_end_vomit = true;
   _moo_b_mute_by_unit = false;
   _moo_b_loop = true;
+  _moo_b_fixed_phase = false;
 
   _moo_fade_fade = 0;
   _moo_master_vol = 1.0f;
@@ -18,8 +47,27 @@ void pxtnService::_moo_constructor() {
 
   _moo_freq = NULL;
   _moo_group_smps = NULL;
+  _moo_group_blks = NULL;
+  _moo_fade_blks = NULL;
+  _moo_stem_blks = NULL;
+  _moo_stem_grps = NULL;
+  _moo_b_stem_units = false;
+  _moo_stem_units = NULL;
+  _moo_stem_num = 0;
+  _moo_unit_mask = NULL;
+  _moo_b_profile = false;
+  _moo_prof_costs = NULL;
+  _moo_prof_tick0 = 0;
+  _moo_prof_ns0 = 0;
+  _moo_prof_tick_null = 0;
+  _moo_active_units = NULL;
+  _moo_active_num = 0;
   _moo_p_eve = NULL;
 
+  _moo_snaps = NULL;
+  _moo_snap_num = 0;
+  _moo_snap_size = 0;
+
   _moo_smp_count = 0;
   _moo_smp_end = 0;
 }
@@ -28,8 +76,18 @@ bool pxtnService::_moo_release() {
   if (!_moo_b_init) return false;
   _moo_b_init = false;
   SAFE_DELETE(_moo_freq);
-  if (_moo_group_smps) free(_moo_group_smps);
-  _moo_group_smps = NULL;
+  pxtnMem_free((void**)&_moo_group_smps);
+  pxtnMem_free((void**)&_moo_group_blks);
+  pxtnMem_free((void**)&_moo_fade_blks);
+  pxtnMem_free((void**)&_moo_stem_blks);
+  pxtnMem_free((void**)&_moo_stem_grps);
+  pxtnMem_free((void**)&_moo_stem_units);
+  _moo_stem_num = 0;
+  pxtnMem_free((void**)&_moo_active_units);
+  _moo_active_num = 0;
+  _moo_b_profile = false;
+  pxtnMem_free((void**)&_moo_prof_costs);
+  moo_snapshot_release();
   return true;
 }
 
@@ -43,7 +101,19 @@ bool pxtnService::_moo_init() {
       !_moo_freq->Init())
     goto term;
   if (!pxtnMem_zero_alloc((void**)&_moo_group_smps,
-                          sizeof(int32_t) * _group_num))
+                          sizeof(int32_t) * _group_num * pxtnMAX_CHANNEL,
+                          pxtnMEM_moo))
+    goto term;
+  if (!pxtnMem_zero_alloc(
+          (void**)&_moo_group_blks,
+          sizeof(int32_t) * _group_num * pxtnMAX_CHANNEL * _MOO_BLOCK,
+          pxtnMEM_moo))
+    goto term;
+  if (!pxtnMem_zero_alloc((void**)&_moo_fade_blks,
+                          sizeof(int32_t) * _MOO_BLOCK, pxtnMEM_moo))
+    goto term;
+  if (!pxtnMem_zero_alloc((void**)&_moo_active_units,
+                          sizeof(pxtnUnit*) * _unit_max, pxtnMEM_moo))
     goto term;
 
   _moo_b_init = true;
@@ -92,17 +162,30 @@ bool pxtnService::_moo_InitUnitTone() {
   for (int32_t u = 0; u < _unit_num; u++) {
     pxtnUnit* p_u = Unit_Get_variable(u);
     p_u->Tone_Init();
+    p_u->Tone_FixedPhase(_moo_b_fixed_phase);
     _moo_ResetVoiceOn(p_u, EVENTDEFAULT_VOICENO);
   }
   return true;
 }
 
-bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data) {
-  if (!_moo_b_init) return false;
+void pxtnService::_moo_ActivateUnit(pxtnUnit* p_u) {
+  if (p_u->get_moo_active()) return;
+  p_u->set_moo_active(true);
+  _moo_active_units[_moo_active_num++] = p_u;
+}
 
-  // envelope..
-  for (int32_t u = 0; u < _unit_num; u++) _units[u]->Tone_Envelope();
+void pxtnService::_moo_ActivateAllUnits() {
+  if (!_moo_b_init) return;
+  _moo_active_num = 0;
+  for (int32_t u = 0; u < _unit_num; u++) {
+    _units[u]->set_moo_active(false);
+    if (_moo_unit_mask && !_moo_unit_mask[u]) continue;
+    _moo_ActivateUnit(_units[u]);
+  }
+}
 
+// events due at the current sample.
+void pxtnService::_moo_PXTONE_EVENTS() {
   int32_t clock = (int32_t)trunc(_moo_smp_count / _moo_clock_rate);
 
   // events..
@@ -114,6 +197,10 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data) {
     const pxtnWoice* p_wc;
     const pxtnVOICEINSTANCE* p_vi;
 
+    if (_moo_unit_mask && !_moo_unit_mask[u]) continue;
+    _moo_ActivateUnit(p_u);
+    int64_t tick = _moo_b_profile ? _moo_Tick() : 0;
+
     switch (_moo_p_eve->kind) {
       case EVENTKIND_ON: {
         int32_t on_count = (int32_t)trunc(
@@ -169,7 +256,11 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data) {
           if (p_tone->life_count > 0) {
             p_tone->on_count = on_count;
             p_tone->smp_pos = 0;
+            p_tone->smp_pos_fx = 0;
             p_tone->env_pos = 0;
+            p_tone->env_seg = 0;
+            p_tone->env_quo = 0;
+            p_tone->env_rem = 0;
             if (p_vi->env_size)
               p_tone->env_volume = p_tone->env_start = 0;  // envelope
             else
@@ -218,53 +309,96 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data) {
         p_u->Tone_Tuning(*((float*)(&_moo_p_eve->value)));
         break;
     }
+    if (_moo_b_profile) _moo_ProfileEvent(u, tick);
   }
+}
 
-  // sampling..
-  for (int32_t u = 0; u < _unit_num; u++) {
-    _units[u]->Tone_Sample(_moo_b_mute_by_unit, _dst_ch_num,
-                           _moo_time_pan_index, _moo_smp_smooth);
+// events and units of one frame, into frame 'blk_pos' of the group block.
+// false once the song (or its fade-out) ends; that frame is not mixed.
+bool pxtnService::_moo_PXTONE_TONES(int32_t blk_pos) {
+  if (!_moo_b_init) return false;
+
+  bool b_tick = _moo_b_profile && !(_moo_smp_count % _MOO_PROFILE_STRIDE);
+
+  // envelope..
+  int64_t tick = b_tick ? _moo_Tick() : 0;
+  for (int32_t a = 0; a < _moo_active_num; a++) {
+    _moo_active_units[a]->Tone_Envelope();
+    if (b_tick) tick = _moo_ProfileUnit(a, tick, 0);
   }
 
-  for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
-    for (int32_t g = 0; g < _group_num; g++) _moo_group_smps[g] = 0;
-    for (int32_t u = 0; u < _unit_num; u++)
-      _units[u]->Tone_Supple(_moo_group_smps, ch, _moo_time_pan_index);
-    for (int32_t o = 0; o < _ovdrv_num; o++)
-      _ovdrvs[o]->Tone_Supple(_moo_group_smps);
-    for (int32_t d = 0; d < _delay_num; d++)
-      _delays[d]->Tone_Supple(ch, _moo_group_smps);
+  _moo_PXTONE_EVENTS();
 
-    // collect.
-    int32_t work = 0;
-    for (int32_t g = 0; g < _group_num; g++) work += _moo_group_smps[g];
+  // one group bus per channel.
+  int32_t* group_smps[pxtnMAX_CHANNEL];
+  for (int32_t ch = 0; ch < pxtnMAX_CHANNEL; ch++) {
+    group_smps[ch] = _moo_group_smps + ch * _group_num;
+    for (int32_t g = 0; g < _group_num; g++) group_smps[ch][g] = 0;
+  }
 
-    // fade..
-    if (_moo_fade_fade) work = work * (_moo_fade_count >> 8) / _moo_fade_max;
+  // sampling..
+  if (b_tick) tick = _moo_Tick();
+  for (int32_t a = 0; a < _moo_active_num; a++) {
+    _moo_active_units[a]->Tone_Sample(_moo_b_mute_by_unit, _dst_ch_num,
+                                      _moo_time_pan_index, _moo_smp_smooth,
+                                      group_smps);
+    if (b_tick)
+      tick = _moo_ProfileUnit(a, tick, 1);
+    else if (_moo_b_profile)
+      _moo_active_units[a]->add_moo_cost(0, 1);
+  }
 
-    // master volume
-    work = (int32_t)trunc(work * _moo_master_vol);
+  for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+    int32_t* p_group = group_smps[ch];
+    if (b_tick) tick = _moo_Tick();
+    for (int32_t a = 0; a < _moo_active_num; a++) {
+      _moo_active_units[a]->Tone_Supple(p_group, ch, _moo_time_pan_index);
+      if (b_tick) tick = _moo_ProfileUnit(a, tick, 0);
+    }
 
-    // to buffer..
-    if (work > _moo_top) work = _moo_top;
-    if (work < -_moo_top) work = -_moo_top;
-    *((int16_t*)p_data + ch) = (int16_t)(work);
+    int32_t* p_blk = &_moo_group_blks[ch * _group_num * _MOO_BLOCK];
+    for (int32_t g = 0; g < _group_num; g++)
+      p_blk[g * _MOO_BLOCK + blk_pos] = p_group[g];
+
+    if (_moo_b_stem_units) {
+      for (int32_t i = 0; i < _moo_stem_num; i++) {
+        int32_t u = _moo_stem_units[i];
+        _moo_stem_blks[(u * pxtnMAX_CHANNEL + ch) * _MOO_BLOCK + blk_pos] =
+            _units[u]->Tone_Supple_Get(ch, _moo_time_pan_index);
+      }
+    }
+  }
+  if (_moo_b_stem_units) {
+    for (int32_t i = 0; i < _moo_stem_num; i++) {
+      int32_t u = _moo_stem_units[i];
+      _moo_stem_grps[u * _MOO_BLOCK + blk_pos] =
+          (uint8_t)_units[u]->Tone_GroupNo_Get();
+    }
   }
 
-  // --------------
-  // increments..
+  _moo_fade_blks[blk_pos] = _moo_fade_fade ? (_moo_fade_count >> 8) : -1;
 
-  _moo_smp_count++;
-  _moo_time_pan_index = (_moo_time_pan_index + 1) & (pxtnBUFSIZE_TIMEPAN - 1);
+  return _moo_PXTONE_NEXT();
+}
 
-  for (int32_t u = 0; u < _unit_num; u++) {
-    int32_t key_now = _units[u]->Tone_Increment_Key();
-    _units[u]->Tone_Increment_Sample(_moo_freq->Get2(key_now) *
-                                     _moo_smp_stride);
+// increments after a frame; false once the song (or its fade-out) ends.
+bool pxtnService::_moo_PXTONE_NEXT() {
+  bool b_tick = _moo_b_profile && !(_moo_smp_count % _MOO_PROFILE_STRIDE);
+  int64_t tick = b_tick ? _moo_Tick() : 0;
+  for (int32_t a = 0; a < _moo_active_num; a++) {
+    pxtnUnit* p_u = _moo_active_units[a];
+    p_u->Tone_Increment_Sample(
+        p_u->Tone_Increment_Pitch(_moo_freq, _moo_smp_stride));
+    if (b_tick) tick = _moo_ProfileUnit(a, tick, 0);
   }
+  _moo_CompactActiveUnits();
+  return _moo_PXTONE_COUNT();
+}
 
-  // delay
-  for (int32_t d = 0; d < _delay_num; d++) _delays[d]->Tone_Increment();
+// position, fade and loop after a frame, without the units.
+bool pxtnService::_moo_PXTONE_COUNT() {
+  _moo_smp_count++;
+  _moo_time_pan_index = (_moo_time_pan_index + 1) & (pxtnBUFSIZE_TIMEPAN - 1);
 
   // fade out
   if (_moo_fade_fade < 0) {
@@ -290,6 +424,75 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data) {
   return true;
 }
 
+void pxtnService::_moo_CompactActiveUnits() {
+  for (int32_t a = 0; a < _moo_active_num;) {
+    pxtnUnit* p_u = _moo_active_units[a];
+    if (p_u->Tone_Is_Idle()) {
+      p_u->set_moo_active(false);
+      _moo_active_units[a] = _moo_active_units[--_moo_active_num];
+    } else {
+      a++;
+    }
+  }
+}
+
+pxtnPROFILECOST* pxtnService::_moo_ProfileCost(pxtnPROFILEKIND kind,
+                                               int32_t idx) const {
+  const int32_t maxes[] = {_unit_max, _woice_max, _delay_max, _ovdrv_max};
+  if (!_moo_prof_costs || idx < 0 || idx >= maxes[kind]) return NULL;
+  int32_t base = 0;
+  for (int32_t k = 0; k < kind; k++) base += maxes[k];
+  return &_moo_prof_costs[base + idx];
+}
+
+// the ticks since 'tick', for the frames that were not timed as well, go to
+// active unit 'a' until the end of the block.
+int64_t pxtnService::_moo_ProfileUnit(int32_t a, int64_t tick,
+                                      int32_t frame_num) {
+  int64_t now = _moo_Tick();
+  int64_t tick_num = now - tick - _moo_prof_tick_null;
+  if (tick_num < 0) tick_num = 0;
+  _moo_active_units[a]->add_moo_cost(tick_num * _MOO_PROFILE_STRIDE,
+                                     frame_num);
+  return now;
+}
+
+int64_t pxtnService::_moo_ProfileEffect(pxtnPROFILEKIND kind, int32_t idx,
+                                        int64_t tick) {
+  int64_t now = _moo_Tick();
+  _moo_ProfileCost(kind, idx)->tick_num += now - tick;
+  return now;
+}
+
+void pxtnService::_moo_ProfileEvent(int32_t u, int64_t tick) {
+  _units[u]->add_moo_cost(_moo_Tick() - tick, 0);
+  _moo_ProfileCost(pxtnPROFILE_unit, u)->event_num++;
+  const pxtnWoice* p_wc = _units[u]->get_woice();
+  for (int32_t w = 0; w < _woice_num; w++) {
+    if (_woices[w] == p_wc) _moo_ProfileCost(pxtnPROFILE_woice, w)->event_num++;
+  }
+}
+
+// the block's unit costs, also to the woice each unit has at its end.
+void pxtnService::_moo_ProfileBlock() {
+  for (int32_t u = 0; u < _unit_num; u++) {
+    int32_t frame_num = 0;
+    int64_t tick_num = _units[u]->take_moo_cost(&frame_num);
+    if (!tick_num && !frame_num) continue;
+
+    pxtnPROFILECOST* p_cost = _moo_ProfileCost(pxtnPROFILE_unit, u);
+    p_cost->tick_num += tick_num;
+    p_cost->frame_num += frame_num;
+    const pxtnWoice* p_wc = _units[u]->get_woice();
+    for (int32_t w = 0; w < _woice_num; w++) {
+      if (_woices[w] != p_wc) continue;
+      p_cost = _moo_ProfileCost(pxtnPROFILE_woice, w);
+      p_cost->tick_num += tick_num;
+      p_cost->frame_num += frame_num;
+    }
+  }
+}
+
 ///////////////////////
 // get / set
 ///////////////////////
@@ -327,6 +530,15 @@ bool pxtnService::moo_set_loop(bool b) {
   return true;
 }
 
+// takes effect from the next moo_preparation(NULL). a moo_preparation() with
+// a pxtnVOMITPREPARATION sets it from pxtnVOMITPREPFLAG_fixed_phase instead,
+// as it does the loop and mute settings.
+bool pxtnService::moo_set_fixed_phase(bool b) {
+  if (!_moo_b_init) return false;
+  _moo_b_fixed_phase = b;
+  return true;
+}
+
 bool pxtnService::moo_set_fade(int32_t fade, float sec) {
   if (!_moo_b_init) return false;
   _moo_fade_max = (int32_t)trunc((float)_dst_sps * sec) >> 8;
@@ -356,6 +568,7 @@ bool pxtnService::moo_preparation(const pxtnVOMITPREPARATION* p_prep) {
     _moo_b_end_vomit = true;
     return false;
   }
+  pxtnTRACE_SCOPE("moo_preparation", -1);
 
   bool b_ret = false;
   int32_t start_meas = 0;
@@ -383,6 +596,10 @@ bool pxtnService::moo_preparation(const pxtnVOMITPREPARATION* p_prep) {
       _moo_b_loop = true;
     else
       _moo_b_loop = false;
+    if (p_prep->flags & pxtnVOMITPREPFLAG_fixed_phase)
+      _moo_b_fixed_phase = true;
+    else
+      _moo_b_fixed_phase = false;
 
     _moo_master_vol = p_prep->master_volume;
   }
@@ -412,10 +629,14 @@ bool pxtnService::moo_preparation(const pxtnVOMITPREPARATION* p_prep) {
                                     (double)_moo_bt_clock * _moo_clock_rate);
   }
 
-  _moo_smp_count = _moo_smp_start;
+  bool b_fast_forward = p_prep &&
+                        (p_prep->flags & pxtnVOMITPREPFLAG_fast_forward) &&
+                        _moo_smp_start > 0;
+
+  _moo_smp_count = b_fast_forward ? 0 : _moo_smp_start;
   _moo_smp_smooth = _dst_sps / 250;  // (0.004sec) // (0.010sec)
 
-  if (fadein_sec > 0)
+  if (fadein_sec > 0 && !b_fast_forward)
     moo_set_fade(1, fadein_sec);
   else
     moo_set_fade(0, 0);
@@ -425,6 +646,7 @@ bool pxtnService::moo_preparation(const pxtnVOMITPREPARATION* p_prep) {
   _moo_p_eve = evels->get_Records();
 
   _moo_InitUnitTone();
+  _moo_ActivateAllUnits();
 
   b_ret = true;
   if (b_ret)
@@ -432,9 +654,595 @@ bool pxtnService::moo_preparation(const pxtnVOMITPREPARATION* p_prep) {
   else
     _moo_b_end_vomit = true;
 
+  // notes and delays that started before the start are heard.
+  if (b_fast_forward) {
+    if (moo_fast_forward(_moo_smp_start) != _moo_smp_start) {
+      _moo_b_end_vomit = true;
+      return false;
+    }
+    if (fadein_sec > 0) moo_set_fade(1, fadein_sec);
+  }
+
+  return b_ret;
+}
+
+////////////////////////////
+// state / snapshots
+////////////////////////////
+
+typedef struct {
+  int32_t smp_count;
+  int32_t time_pan_index;
+  int32_t fade_count;
+  int32_t fade_max;
+  int32_t fade_fade;
+  int32_t unit_num;
+  int32_t delay_num;
+  const EVERECORD* p_eve;
+} _MOOSTATE;
+
+int32_t pxtnService::moo_state_size() const {
+  if (!_moo_b_init) return 0;
+  int32_t size = sizeof(_MOOSTATE) + sizeof(pxtnUNITTONESTATE) * _unit_num;
+  for (int32_t d = 0; d < _delay_num; d++)
+    size += _delays[d]->Tone_State_Size();
+  return size;
+}
+
+bool pxtnService::moo_state_save(void* p_buf, int32_t size) const {
+  if (!_moo_b_init || !p_buf || size != moo_state_size()) return false;
+
+  uint8_t* p = (uint8_t*)p_buf;
+
+  _MOOSTATE st;
+  memset(&st, 0, sizeof(_MOOSTATE));
+  st.smp_count = _moo_smp_count;
+  st.time_pan_index = _moo_time_pan_index;
+  st.fade_count = _moo_fade_count;
+  st.fade_max = _moo_fade_max;
+  st.fade_fade = _moo_fade_fade;
+  st.unit_num = _unit_num;
+  st.delay_num = _delay_num;
+  st.p_eve = _moo_p_eve;
+  memcpy(p, &st, sizeof(_MOOSTATE));
+  p += sizeof(_MOOSTATE);
+
+  for (int32_t u = 0; u < _unit_num; u++) {
+    pxtnUNITTONESTATE ust;
+    memset(&ust, 0, sizeof(pxtnUNITTONESTATE));  // no stray padding.
+    _units[u]->Tone_State_Get(&ust);
+    memcpy(p, &ust, sizeof(pxtnUNITTONESTATE));
+    p += sizeof(pxtnUNITTONESTATE);
+  }
+  for (int32_t d = 0; d < _delay_num; d++) {
+    _delays[d]->Tone_State_Get((int32_t*)p);
+    p += _delays[d]->Tone_State_Size();
+  }
+  return true;
+}
+
+bool pxtnService::moo_state_load(const void* p_buf, int32_t size) {
+  if (!_moo_b_init || !p_buf || size != moo_state_size()) return false;
+
+  const uint8_t* p = (const uint8_t*)p_buf;
+
+  _MOOSTATE st;
+  memcpy(&st, p, sizeof(_MOOSTATE));
+  p += sizeof(_MOOSTATE);
+  if (st.unit_num != _unit_num || st.delay_num != _delay_num) return false;
+
+  _moo_smp_count = st.smp_count;
+  _moo_time_pan_index = st.time_pan_index;
+  _moo_fade_count = st.fade_count;
+  _moo_fade_max = st.fade_max;
+  _moo_fade_fade = st.fade_fade;
+  _moo_p_eve = st.p_eve;
+
+  _moo_active_num = 0;
+  for (int32_t u = 0; u < _unit_num; u++) {
+    pxtnUNITTONESTATE ust;
+    memcpy(&ust, p, sizeof(pxtnUNITTONESTATE));
+    p += sizeof(pxtnUNITTONESTATE);
+    _units[u]->Tone_State_Set(&ust);
+    if (ust.b_moo_active) _moo_active_units[_moo_active_num++] = _units[u];
+  }
+  for (int32_t d = 0; d < _delay_num; d++) {
+    _delays[d]->Tone_State_Set((const int32_t*)p);
+    p += _delays[d]->Tone_State_Size();
+  }
+  return true;
+}
+
+// renders 'smp_num' frames without mixing them; returns the frames done.
+int32_t pxtnService::_moo_Advance(int32_t smp_num) {
+  int32_t smp_w = 0;
+  while (!_moo_b_end_vomit && smp_w < smp_num) {
+    int32_t blk_num = smp_num - smp_w;
+    if (blk_num > _MOO_BLOCK) blk_num = _MOO_BLOCK;
+
+    bool b_end = false;
+    int32_t num = _moo_PXTONE_BLOCK(blk_num, &b_end);
+    _moo_PXTONE_EFFECTS(num);
+    smp_w += num;
+
+    if (b_end) _moo_b_end_vomit = true;
+  }
+  return smp_w;
+}
+
+// first sample from now at which events of 'clock' run.
+int32_t pxtnService::_moo_EventSample(int32_t clock) const {
+  int32_t smp = (int32_t)(clock * _moo_clock_rate);
+  if (smp < _moo_smp_count) smp = _moo_smp_count;
+  while (smp > _moo_smp_count &&
+         (int32_t)trunc((smp - 1) / _moo_clock_rate) >= clock)
+    smp--;
+  while ((int32_t)trunc(smp / _moo_clock_rate) < clock) smp++;
+  return smp;
+}
+
+static bool _moo_UnitsSound(pxtnUnit* const* units, int32_t num) {
+  for (int32_t a = 0; a < num; a++) {
+    if (!units[a]->Tone_Is_Silent()) return true;
+  }
+  return false;
+}
+
+// counts the frames in which no unit sounded; true where the count first
+// reaches 'quiet_num'.
+static bool _moo_CountQuiet(int32_t* p_quiet, int32_t quiet_num, bool b_live,
+                            int32_t num) {
+  if (b_live) {
+    *p_quiet = 0;
+    return false;
+  }
+  bool b_below = *p_quiet < quiet_num;
+  if (*p_quiet > 0x7fffffff - num)
+    *p_quiet = 0x7fffffff;
+  else
+    *p_quiet += num;
+  return b_below && *p_quiet >= quiet_num;
+}
+
+// state only: events, envelopes, life counts and phase. nothing is sampled or
+// mixed, and between events each unit runs its whole span on its own.
+// 'p_quiet', if given, counts the frames no unit fed the groups, and
+// the skip stops where that count first reaches 'quiet_num'.
+int32_t pxtnService::_moo_Skip(int32_t smp_num, int32_t* p_quiet,
+                               int32_t quiet_num) {
+  int32_t smp_w = 0;
+  while (!_moo_b_end_vomit && smp_w < smp_num) {
+    // one frame with its events.
+    for (int32_t a = 0; a < _moo_active_num; a++)
+      _moo_active_units[a]->Tone_Envelope();
+    _moo_PXTONE_EVENTS();
+    for (int32_t a = 0; a < _moo_active_num; a++)
+      _moo_active_units[a]->Tone_Skip_Sample(_moo_b_mute_by_unit);
+    bool b_live = _moo_UnitsSound(_moo_active_units, _moo_active_num);
+    if (!_moo_PXTONE_NEXT()) {
+      _moo_b_end_vomit = true;
+      break;
+    }
+    smp_w++;
+    if (p_quiet && _moo_CountQuiet(p_quiet, quiet_num, b_live, 1)) break;
+
+    // the frames before the next event, fade change or end, but the last.
+    if (_moo_fade_fade) continue;
+    int32_t span = smp_num - smp_w;
+    if (span > _moo_smp_end - _moo_smp_count)
+      span = _moo_smp_end - _moo_smp_count;
+    if (_moo_p_eve) {
+      int32_t eve_num = _moo_EventSample(_moo_p_eve->clock) - _moo_smp_count;
+      if (span > eve_num) span = eve_num;
+    }
+    span--;
+    if (span <= 0) continue;
+
+    b_live = _moo_UnitsSound(_moo_active_units, _moo_active_num);
+    for (int32_t a = 0; a < _moo_active_num; a++)
+      _moo_active_units[a]->Tone_Skip(span, _moo_b_mute_by_unit, _moo_freq,
+                                      _moo_smp_stride);
+    _moo_CompactActiveUnits();
+    _moo_smp_count += span;
+    _moo_time_pan_index =
+        (_moo_time_pan_index + span) & (pxtnBUFSIZE_TIMEPAN - 1);
+    smp_w += span;
+    if (p_quiet && _moo_CountQuiet(p_quiet, quiet_num, b_live, span)) break;
+  }
+
+  for (int32_t d = 0; d < _delay_num; d++) _delays[d]->Tone_Increment_Block(smp_w);
+  return smp_w;
+}
+
+int32_t pxtnService::moo_fast_forward(int32_t smp_num, bool b_delays) {
+  int32_t quiet = 0;
+  return _moo_FastForward(smp_num, b_delays, &quiet);
+}
+
+// moo_fast_forward(); '*p_quiet' carries the frames no unit has sounded from
+// one call to the next.
+int32_t pxtnService::_moo_FastForward(int32_t smp_num, bool b_delays,
+                                      int32_t* p_quiet) {
+  if (!_moo_b_init || !_moo_b_valid_data || _moo_b_end_vomit) return 0;
+  if (smp_num <= 0) return 0;
+
+  // rendered: the time-pan ring before the target.
+  int32_t tail = pxtnBUFSIZE_TIMEPAN;
+
+  // the delays hold only zeros once no unit has fed them for 'decay_num'.
+  int32_t decay_num = 0;
+  for (int32_t d = 0; b_delays && d < _delay_num; d++) {
+    int32_t num = _delays[d]->Tone_Decay_Num();
+    if (num < 0 || num > 0x7fffffff - decay_num) {
+      decay_num = -1;
+      break;
+    }
+    decay_num += num;
+  }
+
+  int32_t skip_num = smp_num - tail;
+  if (skip_num <= 0 || decay_num < 0) return _moo_Advance(smp_num);
+
+  // the delays are rendered from here, or from the last point where they had
+  // decayed; what is skipped after it only moves their offsets.
+  int32_t size = moo_state_size();
+  uint8_t* p_from = NULL;
+  if (!pxtnMem_zero_alloc((void**)&p_from, size, pxtnMEM_moo)) return 0;
+  moo_state_save(p_from, size);
+
+  int32_t smp_from = 0;
+  int32_t smp_w = 0;
+  while (!_moo_b_end_vomit && smp_w < skip_num) {
+    smp_w += _moo_Skip(skip_num - smp_w, p_quiet, decay_num);
+    if (*p_quiet < decay_num) continue;
+    for (int32_t d = 0; d < _delay_num; d++) _delays[d]->Tone_Clear();
+    if (smp_w >= skip_num) break;
+    moo_state_save(p_from, size);
+    smp_from = smp_w;
+  }
+  if (smp_w < skip_num) {
+    pxtnMem_free((void**)&p_from);
+    return smp_w;
+  }
+  if (*p_quiet < decay_num) {
+    moo_state_load(p_from, size);
+    smp_w = smp_from;
+  }
+  pxtnMem_free((void**)&p_from);
+  return smp_w + _moo_Advance(smp_num - smp_w);
+}
+
+bool pxtnService::moo_set_profile(bool b) {
+  if (!_moo_b_init) return false;
+  _moo_b_profile = false;
+  pxtnMem_free((void**)&_moo_prof_costs);
+  if (!b) return true;
+
+  if (!pxtnMem_zero_alloc(
+          (void**)&_moo_prof_costs,
+          sizeof(pxtnPROFILECOST) *
+              (_unit_max + _woice_max + _delay_max + _ovdrv_max),
+          pxtnMEM_moo))
+    return false;
+  for (int32_t u = 0; u < _unit_num; u++) {
+    int32_t frame_num = 0;
+    _units[u]->take_moo_cost(&frame_num);
+  }
+  _moo_prof_tick_null = 0x7fffffff;
+  for (int32_t i = 0; i < 64; i++) {
+    int64_t tick = _moo_Tick();
+    tick = _moo_Tick() - tick;
+    if (tick < _moo_prof_tick_null) _moo_prof_tick_null = tick;
+  }
+  _moo_prof_tick0 = _moo_Tick();
+  _moo_prof_ns0 = _moo_Ns();
+  _moo_b_profile = true;
+  return true;
+}
+
+bool pxtnService::moo_get_profile(pxtnPROFILEKIND kind, int32_t idx,
+                                  pxtnPROFILECOST* p_cost) const {
+  const pxtnPROFILECOST* p = _moo_ProfileCost(kind, idx);
+  if (!p || !p_cost) return false;
+  *p_cost = *p;
+  return true;
+}
+
+double pxtnService::moo_get_profile_tick_sec() const {
+  if (!_moo_b_profile) return 0;
+  int64_t tick_num = _moo_Tick() - _moo_prof_tick0;
+  if (tick_num <= 0) return 1e-9;
+  return (_moo_Ns() - _moo_prof_ns0) * 1e-9 / tick_num;
+}
+
+void pxtnService::moo_snapshot_release() {
+  pxtnMem_free((void**)&_moo_snaps);
+  _moo_snap_num = 0;
+  _moo_snap_size = 0;
+}
+
+pxtnERR pxtnService::moo_snapshot_build(const pxtnVOMITPREPARATION* p_prep,
+                                        int32_t meas_interval) {
+  if (!_moo_b_init) return pxtnERR_INIT;
+  if (meas_interval <= 0) return pxtnERR_param;
+
+  moo_snapshot_release();
+
+  pxtnERR res = pxtnERR_VOID;
+  pxtnVOMITPREPARATION prep;
+  memset(&prep, 0, sizeof(pxtnVOMITPREPARATION));
+  if (p_prep) prep = *p_prep;
+  prep.start_pos_meas = 0;
+  prep.start_pos_sample = 0;
+  prep.start_pos_float = 0;
+  prep.fadein_sec = 0;
+  prep.flags &= ~pxtnVOMITPREPFLAG_loop;
+
+  if (!moo_preparation(&prep)) return pxtnERR_moo_init;
+
+  double smp_per_meas =
+      (double)_moo_bt_num * (double)_moo_bt_clock * _moo_clock_rate;
+  int32_t snap_max = 0;
+  while ((int32_t)trunc(snap_max * meas_interval * smp_per_meas) < _moo_smp_end)
+    snap_max++;
+
+  int32_t quiet = 0;
+  _moo_snap_size = moo_state_size();
+  if (!pxtnMem_zero_alloc((void**)&_moo_snaps,
+                          (uint32_t)_moo_snap_size * snap_max, pxtnMEM_moo)) {
+    res = pxtnERR_memory;
+    goto term;
+  }
+
+  for (int32_t i = 0; i < snap_max; i++) {
+    int32_t smp_num =
+        (int32_t)trunc(i * meas_interval * smp_per_meas) - _moo_smp_count;
+    if (smp_num > 0 && _moo_FastForward(smp_num, true, &quiet) != smp_num) break;
+    if (!moo_state_save(&_moo_snaps[_moo_snap_size * i], _moo_snap_size))
+      goto term;
+    _moo_snap_num++;
+  }
+
+  res = pxtnOK;
+term:
+  if (res != pxtnOK) moo_snapshot_release();
+  _moo_b_end_vomit = true;  // moo_preparation() before playing.
+  return res;
+}
+
+bool pxtnService::moo_seek(int32_t smp_pos) {
+  if (!_moo_b_init || !_moo_snap_num) return false;
+  if (smp_pos < 0 || smp_pos >= _moo_smp_end) return false;
+
+  const uint8_t* p_snap = NULL;
+  for (int32_t i = 0; i < _moo_snap_num; i++) {
+    const uint8_t* p = &_moo_snaps[_moo_snap_size * i];
+    _MOOSTATE st;
+    memcpy(&st, p, sizeof(_MOOSTATE));
+    if (st.smp_count > smp_pos) break;
+    p_snap = p;
+  }
+  if (!p_snap) return false;
+
+  int32_t fade_count = _moo_fade_count;
+  int32_t fade_max = _moo_fade_max;
+  int32_t fade_fade = _moo_fade_fade;
+
+  if (!moo_state_load(p_snap, _moo_snap_size)) return false;
+  _moo_fade_fade = 0;
+  _moo_b_end_vomit = false;
+  int32_t smp_num = smp_pos - _moo_smp_count;
+  bool b_ret = (_moo_Advance(smp_num) == smp_num);
+
+  _moo_fade_count = fade_count;
+  _moo_fade_max = fade_max;
+  _moo_fade_fade = fade_fade;
   return b_ret;
 }
 
+// first event from the current sample on; the list may have changed since
+// the state was kept.
+void pxtnService::_moo_FindEvent() {
+  int32_t clock = _moo_smp_count
+                      ? (int32_t)trunc((_moo_smp_count - 1) / _moo_clock_rate)
+                      : -1;
+  _moo_p_eve = evels->get_Records();
+  while (_moo_p_eve && _moo_p_eve->clock <= clock) _moo_p_eve = _moo_p_eve->next;
+}
+
+// a voice out of life is reset by its next note; what it left is not kept.
+static bool _moo_VoiceSame(const pxtnVOICETONE* p1, const pxtnVOICETONE* p2) {
+  if (p1->smp_step_fx != p2->smp_step_fx ||
+      p1->offset_freq != p2->offset_freq ||
+      p1->env_release_clock != p2->env_release_clock)
+    return false;
+  if (p1->life_count <= 0 && p2->life_count <= 0) return true;
+  return p1->smp_pos == p2->smp_pos && p1->smp_pos_fx == p2->smp_pos_fx &&
+         p1->env_volume == p2->env_volume &&
+         p1->life_count == p2->life_count && p1->on_count == p2->on_count &&
+         p1->smp_count == p2->smp_count && p1->env_start == p2->env_start &&
+         p1->env_pos == p2->env_pos && p1->env_seg == p2->env_seg &&
+         p1->env_quo == p2->env_quo && p1->env_rem == p2->env_rem &&
+         p1->smooth_volume == p2->smooth_volume;
+}
+
+// the time-pan rings are compared back from each state's own index.
+static bool _moo_UnitSame(const pxtnUNITTONESTATE* p1, int32_t index1,
+                          const pxtnUNITTONESTATE* p2, int32_t index2) {
+  if (p1->key_now != p2->key_now || p1->key_start != p2->key_start ||
+      p1->key_margin != p2->key_margin ||
+      p1->portament_sample_pos != p2->portament_sample_pos ||
+      p1->portament_sample_num != p2->portament_sample_num ||
+      p1->v_VOLUME != p2->v_VOLUME || p1->v_VELOCITY != p2->v_VELOCITY ||
+      p1->v_GROUPNO != p2->v_GROUPNO || p1->v_TUNING != p2->v_TUNING ||
+      p1->silent_count != p2->silent_count ||
+      p1->b_moo_active != p2->b_moo_active ||
+      p1->b_pitch_dirty != p2->b_pitch_dirty ||
+      p1->pitch_step != p2->pitch_step ||
+      p1->b_fixed_dirty != p2->b_fixed_dirty ||
+      p1->fixed_freq != p2->fixed_freq || p1->p_woice != p2->p_woice)
+    return false;
+  if (memcmp(p1->pan_vols, p2->pan_vols, sizeof(p1->pan_vols)) ||
+      memcmp(p1->pan_times, p2->pan_times, sizeof(p1->pan_times)))
+    return false;
+  for (int32_t ch = 0; ch < pxtnMAX_CHANNEL; ch++) {
+    for (int32_t i = 0; i < pxtnBUFSIZE_TIMEPAN; i++) {
+      if (p1->pan_time_bufs[ch][(index1 - i) & (pxtnBUFSIZE_TIMEPAN - 1)] !=
+          p2->pan_time_bufs[ch][(index2 - i) & (pxtnBUFSIZE_TIMEPAN - 1)])
+        return false;
+    }
+  }
+  for (int32_t v = 0; v < pxtnMAX_UNITCONTROLVOICE; v++) {
+    if (!_moo_VoiceSame(&p1->vts[v], &p2->vts[v])) return false;
+  }
+  return true;
+}
+
+bool pxtnService::moo_state_same(const void* p_buf1, const void* p_buf2,
+                                 int32_t size) const {
+  if (!_moo_b_init || !p_buf1 || !p_buf2 || size != moo_state_size())
+    return false;
+
+  const uint8_t* p1 = (const uint8_t*)p_buf1;
+  const uint8_t* p2 = (const uint8_t*)p_buf2;
+
+  _MOOSTATE st1, st2;
+  memcpy(&st1, p1, sizeof(_MOOSTATE));
+  memcpy(&st2, p2, sizeof(_MOOSTATE));
+  if (st1.smp_count != st2.smp_count ||
+      st1.fade_count != st2.fade_count || st1.fade_max != st2.fade_max ||
+      st1.fade_fade != st2.fade_fade || st1.unit_num != st2.unit_num ||
+      st1.delay_num != st2.delay_num || st1.p_eve != st2.p_eve)
+    return false;
+  p1 += sizeof(_MOOSTATE);
+  p2 += sizeof(_MOOSTATE);
+
+  for (int32_t u = 0; u < _unit_num; u++) {
+    pxtnUNITTONESTATE ust1, ust2;
+    memcpy(&ust1, p1, sizeof(pxtnUNITTONESTATE));
+    memcpy(&ust2, p2, sizeof(pxtnUNITTONESTATE));
+    if (!_moo_UnitSame(&ust1, st1.time_pan_index, &ust2, st2.time_pan_index))
+      return false;
+    p1 += sizeof(pxtnUNITTONESTATE);
+    p2 += sizeof(pxtnUNITTONESTATE);
+  }
+  // delays are an offset and a ring per channel, compared from the offset.
+  for (int32_t d = 0; d < _delay_num; d++) {
+    int32_t smp_num = _delays[d]->Tone_Sample_Num();
+    const int32_t* p_d1 = (const int32_t*)p1;
+    const int32_t* p_d2 = (const int32_t*)p2;
+    for (int32_t ch = 0; ch < pxtnMAX_CHANNEL && smp_num; ch++) {
+      const int32_t* p_ring1 = &p_d1[1 + ch * smp_num];
+      const int32_t* p_ring2 = &p_d2[1 + ch * smp_num];
+      for (int32_t i = 0, i1 = p_d1[0], i2 = p_d2[0]; i < smp_num; i++) {
+        if (p_ring1[i1] != p_ring2[i2]) return false;
+        if (++i1 >= smp_num) i1 = 0;
+        if (++i2 >= smp_num) i2 = 0;
+      }
+    }
+    p1 += _delays[d]->Tone_State_Size();
+    p2 += _delays[d]->Tone_State_Size();
+  }
+  return true;
+}
+
+pxtnERR pxtnService::moo_render_range(int32_t clock1, int32_t clock2,
+                                      void* p_buf, int32_t size,
+                                      int32_t* p_smp1, int32_t* p_smp2) {
+  if (!_moo_b_init || !_moo_b_valid_data || !_moo_snap_num)
+    return pxtnERR_INIT;
+  if (!p_buf || size % _dst_byte_per_smp || clock1 > clock2)
+    return pxtnERR_param;
+  if (size / _dst_byte_per_smp < _moo_smp_end) return pxtnERR_param;
+
+  pxtnERR res = pxtnERR_VOID;
+  uint8_t* p_work = NULL;
+  uint8_t* p_dst = (uint8_t*)p_buf;
+  int32_t snap = 0;
+  int32_t smp1 = 0;
+
+  // notes before clock1 are cut short by the next note of their unit if it
+  // starts before their release ends.
+  int32_t rls_clock = 0;
+  for (int32_t w = 0; w < _woice_num; w++) {
+    for (int32_t v = 0; v < _woices[w]->get_voice_num(); v++) {
+      int32_t c =
+          (int32_t)trunc(_woices[w]->get_instance(v)->env_release /
+                         _moo_clock_rate);
+      if (c > rls_clock) rls_clock = c;
+    }
+  }
+  int32_t clock_top = clock1;
+  for (const EVERECORD* p = evels->get_Records(); p && p->clock < clock1;
+       p = p->next) {
+    if (p->kind == EVENTKIND_ON && p->clock < clock_top &&
+        p->clock + p->value + rls_clock >= clock1)
+      clock_top = p->clock;
+  }
+
+  // the last snapshot before any frame that runs those events.
+  for (int32_t i = 1; i < _moo_snap_num; i++) {
+    _MOOSTATE st;
+    memcpy(&st, &_moo_snaps[_moo_snap_size * i], sizeof(_MOOSTATE));
+    if ((int32_t)trunc((st.smp_count - 1) / _moo_clock_rate) >= clock_top)
+      break;
+    snap = i;
+  }
+
+  if (!pxtnMem_zero_alloc((void**)&p_work, _moo_snap_size, pxtnMEM_moo)) {
+    res = pxtnERR_memory;
+    goto term;
+  }
+  if (!moo_state_load(&_moo_snaps[_moo_snap_size * snap], _moo_snap_size)) {
+    res = pxtnERR_FATAL;
+    goto term;
+  }
+  _moo_FindEvent();
+  _moo_b_end_vomit = false;
+  smp1 = _moo_smp_count;
+
+  // up to each later snapshot; stop once the state is the one kept there.
+  for (snap++; !_moo_b_end_vomit; snap++) {
+    int32_t smp_to = _moo_smp_end;
+    uint8_t* p_snap = NULL;
+    if (snap < _moo_snap_num) {
+      p_snap = &_moo_snaps[_moo_snap_size * snap];
+      _MOOSTATE st;
+      memcpy(&st, p_snap, sizeof(_MOOSTATE));
+      smp_to = st.smp_count;
+    }
+
+    while (!_moo_b_end_vomit && _moo_smp_count < smp_to) {
+      int32_t blk_num = smp_to - _moo_smp_count;
+      if (blk_num > _MOO_BLOCK) blk_num = _MOO_BLOCK;
+
+      bool b_end = false;
+      uint8_t* p8 = p_dst + (size_t)_moo_smp_count * _dst_byte_per_smp;
+      int32_t num = _moo_PXTONE_BLOCK(blk_num, &b_end);
+      _moo_PXTONE_MIX(p8, num);
+      if (b_end) _moo_b_end_vomit = true;
+    }
+    if (!p_snap || _moo_b_end_vomit) break;
+
+    if (!moo_state_save(p_work, _moo_snap_size)) {
+      res = pxtnERR_FATAL;
+      goto term;
+    }
+    if ((int32_t)trunc((smp_to - 1) / _moo_clock_rate) >= clock2 &&
+        moo_state_same(p_work, p_snap, _moo_snap_size))
+      break;
+    memcpy(p_snap, p_work, _moo_snap_size);
+  }
+
+  if (p_smp1) *p_smp1 = smp1;
+  if (p_smp2) *p_smp2 = _moo_smp_count;
+  res = pxtnOK;
+term:
+  pxtnMem_free((void**)&p_work);
+  _moo_b_end_vomit = true;  // moo_preparation() before playing.
+  return res;
+}
+
 int32_t pxtnService::moo_get_sampling_offset() const {
   if (!_moo_b_init) return 0;
   if (_moo_b_end_vomit) return 0;
@@ -447,6 +1255,12 @@ int32_t pxtnService::moo_get_sampling_end() const {
   return _moo_smp_end;
 }
 
+int32_t pxtnService::moo_get_sampling_repeat() const {
+  if (!_moo_b_init) return 0;
+  if (_moo_b_end_vomit) return 0;
+  return _moo_smp_repeat;
+}
+
 int32_t pxtnService::moo_get_total_sample() const {
   if (!_b_init) return 0;
   if (!_moo_b_valid_data) return 0;
@@ -513,6 +1327,145 @@ bool pxtnService::moo_set_master_volume(float v) {
 //  return b_ret;
 //}
 
+static inline int32_t _moo_Collect(const int32_t* p_blk, int32_t group_num,
+                                   int32_t i) {
+  int32_t work = 0;
+  for (int32_t g = 0; g < group_num; g++) work += p_blk[g * _MOO_BLOCK + i];
+  return work;
+}
+
+// wide bus: fade and master volume keep their fraction, no 16-bit clip.
+static inline double _moo_Wide(int32_t work, int32_t fade, int32_t fade_max,
+                               float master_vol) {
+  double w = work;
+  if (fade >= 0) w = w * fade / fade_max;
+  return w * master_vol;
+}
+
+// events and units of up to 'num' frames into the group block.
+int32_t pxtnService::_moo_PXTONE_BLOCK(int32_t num, bool* pb_end) {
+  *pb_end = false;
+  int32_t i = 0;
+  for (; i < num; i++) {
+    if (!_moo_PXTONE_TONES(i)) {
+      *pb_end = true;
+      break;
+    }
+  }
+  if (_moo_b_profile) _moo_ProfileBlock();
+  return i;
+}
+
+// overdrives and delays over 'num' frames of the group block.
+void pxtnService::_moo_PXTONE_EFFECTS(int32_t num) {
+  int64_t tick = _moo_b_profile ? _moo_Tick() : 0;
+  for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+    int32_t* p_blk = &_moo_group_blks[ch * _group_num * _MOO_BLOCK];
+    for (int32_t o = 0; o < _ovdrv_num; o++) {
+      _ovdrvs[o]->Tone_Supple_Block(p_blk, _MOO_BLOCK, num);
+      if (_moo_b_profile)
+        tick = _moo_ProfileEffect(pxtnPROFILE_overdrive, o, tick);
+    }
+    for (int32_t d = 0; d < _delay_num; d++) {
+      _delays[d]->Tone_Supple_Block(ch, p_blk, _MOO_BLOCK, num);
+      if (_moo_b_profile) tick = _moo_ProfileEffect(pxtnPROFILE_delay, d, tick);
+    }
+  }
+
+  // delay
+  for (int32_t d = 0; d < _delay_num; d++) {
+    _delays[d]->Tone_Increment_Block(num);
+    if (_moo_b_profile) tick = _moo_ProfileEffect(pxtnPROFILE_delay, d, tick);
+  }
+
+  if (_moo_b_profile) {
+    for (int32_t o = 0; o < _ovdrv_num; o++)
+      _moo_ProfileCost(pxtnPROFILE_overdrive, o)->frame_num += num;
+    for (int32_t d = 0; d < _delay_num; d++)
+      _moo_ProfileCost(pxtnPROFILE_delay, d)->frame_num += num;
+  }
+}
+
+// mixdown of 'num' frames of the group block, interleaved.
+void pxtnService::_moo_PXTONE_MIX(void* p_dst, int32_t num) {
+  _moo_PXTONE_EFFECTS(num);
+
+  int32_t works[_MOO_BLOCK];
+  for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+    const int32_t* p_blk = &_moo_group_blks[ch * _group_num * _MOO_BLOCK];
+    // collect.
+    for (int32_t i = 0; i < num; i++)
+      works[i] = _moo_Collect(p_blk, _group_num, i);
+    _moo_PXTONE_OUT(p_dst, ch, works, num);
+  }
+}
+
+// fade, master volume and the destination format for 'num' frames of one
+// channel, interleaved into p_dst.
+void pxtnService::_moo_PXTONE_OUT(void* p_dst, int32_t ch,
+                                  const int32_t* p_src, int32_t num) const {
+  switch (_dst_format) {
+    case pxtnDSTFORMAT_int16: {
+      int16_t* p16 = (int16_t*)p_dst;
+      for (int32_t i = 0; i < num; i++) {
+        int32_t work = p_src[i];
+
+        // fade..
+        if (_moo_fade_blks[i] >= 0)
+          work = work * _moo_fade_blks[i] / _moo_fade_max;
+
+        // master volume
+        work = (int32_t)trunc(work * _moo_master_vol);
+
+        // to buffer..
+        if (work > _moo_top) work = _moo_top;
+        if (work < -_moo_top) work = -_moo_top;
+        p16[i * _dst_ch_num + ch] = (int16_t)(work);
+      }
+      break;
+    }
+    case pxtnDSTFORMAT_int32: {
+      int32_t* p32 = (int32_t*)p_dst;
+      for (int32_t i = 0; i < num; i++) {
+        double work = _moo_Wide(p_src[i], _moo_fade_blks[i], _moo_fade_max,
+                                _moo_master_vol) *
+                      65536.0;
+        if (work > 2147483647.0) work = 2147483647.0;
+        if (work < -2147483647.0) work = -2147483647.0;
+        p32[i * _dst_ch_num + ch] = (int32_t)work;
+      }
+      break;
+    }
+    case pxtnDSTFORMAT_float32: {
+      float* pf = (float*)p_dst;
+      for (int32_t i = 0; i < num; i++) {
+        pf[i * _dst_ch_num + ch] =
+            (float)(_moo_Wide(p_src[i], _moo_fade_blks[i], _moo_fade_max,
+                              _moo_master_vol) /
+                    32768.0);
+      }
+      break;
+    }
+  }
+}
+
+// mixdown of 'num' frames of the group block, one float buffer per channel.
+void pxtnService::_moo_PXTONE_MIX_planar(float* const* pp_dst, int32_t pos,
+                                         int32_t num) {
+  _moo_PXTONE_EFFECTS(num);
+
+  for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+    const int32_t* p_blk = &_moo_group_blks[ch * _group_num * _MOO_BLOCK];
+    float* pf = &pp_dst[ch][pos];
+    for (int32_t i = 0; i < num; i++) {
+      pf[i] = (float)(_moo_Wide(_moo_Collect(p_blk, _group_num, i),
+                                _moo_fade_blks[i], _moo_fade_max,
+                                _moo_master_vol) /
+                      32768.0);
+    }
+  }
+}
+
 int32_t pxtnService::Moo(void* p_buf, int32_t size, int32_t* filled_size) {
   if (!_moo_b_init) return 0;
   if (!_moo_b_valid_data) return 0;
@@ -525,17 +1478,23 @@ int32_t pxtnService::Moo(void* p_buf, int32_t size, int32_t* filled_size) {
   int32_t smp_num = size / _dst_byte_per_smp;
 
   {
-    int16_t* p16 = (int16_t*)p_buf;
-    int16_t sample[2];
+    uint8_t* p8 = (uint8_t*)p_buf;
 
-    for (smp_w = 0; smp_w < smp_num; smp_w++) {
-      if (!_moo_PXTONE_SAMPLE(sample)) {
+    while (smp_w < smp_num) {
+      int32_t blk_num = smp_num - smp_w;
+      if (blk_num > _MOO_BLOCK) blk_num = _MOO_BLOCK;
+      pxtnTRACE_SCOPE("moo_block", blk_num);
+
+      bool b_end = false;
+      int32_t num = _moo_PXTONE_BLOCK(blk_num, &b_end);
+      _moo_PXTONE_MIX(p8, num);
+      p8 += num * _dst_byte_per_smp;
+      smp_w += num;
+
+      if (b_end) {
         _moo_b_end_vomit = true;
         break;
       }
-
-      for (int ch = 0; ch < _dst_ch_num; ch++, p16++) *p16 = sample[ch];
-      p_buf = p16;
     }
   }
   if (filled_size) *filled_size = smp_num * _dst_byte_per_smp;
@@ -549,6 +1508,224 @@ int32_t pxtnService::Moo(void* p_buf, int32_t size, int32_t* filled_size) {
   return smp_w;
 }
 
+// no allocation or locking; frames after the end of the song are zeroed.
+int32_t pxtnService::Moo_planar(float* const* channels, int32_t frames) {
+  if (!_moo_b_init) return 0;
+  if (!_moo_b_valid_data) return 0;
+  if (!channels || frames <= 0) return 0;
+
+  int32_t smp_w = 0;
+
+  while (!_moo_b_end_vomit && smp_w < frames) {
+    int32_t blk_num = frames - smp_w;
+    if (blk_num > _MOO_BLOCK) blk_num = _MOO_BLOCK;
+    pxtnTRACE_SCOPE("moo_block", blk_num);
+
+    bool b_end = false;
+    int32_t num = _moo_PXTONE_BLOCK(blk_num, &b_end);
+    _moo_PXTONE_MIX_planar(channels, smp_w, num);
+    smp_w += num;
+
+    if (b_end) _moo_b_end_vomit = true;
+  }
+
+  for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+    for (int32_t i = smp_w; i < frames; i++) channels[ch][i] = 0;
+  }
+
+  if (smp_w && _sampled_proc) {
+    if (!_sampled_proc(_sampled_user, this)) _moo_b_end_vomit = true;
+  }
+  return smp_w;
+}
+
+bool pxtnService::_moo_AllocStems() {
+  if (_moo_stem_blks) return true;
+  if (!pxtnMem_zero_alloc((void**)&_moo_stem_units,
+                          sizeof(int32_t) * _unit_max, pxtnMEM_moo))
+    return false;
+  if (!pxtnMem_zero_alloc((void**)&_moo_stem_grps,
+                          sizeof(uint8_t) * _unit_max * _MOO_BLOCK,
+                          pxtnMEM_moo))
+    return false;
+  return pxtnMem_zero_alloc(
+      (void**)&_moo_stem_blks,
+      sizeof(int32_t) * _unit_max * pxtnMAX_CHANNEL * _MOO_BLOCK, pxtnMEM_moo);
+}
+
+int32_t pxtnService::moo_stem_num(pxtnSTEMMODE mode) const {
+  return mode == pxtnSTEM_unit ? _unit_num : _group_num;
+}
+
+int32_t pxtnService::Moo_stems(pxtnSTEMMODE mode, void* const* p_stems,
+                               void* p_mix, int32_t frames) {
+  if (!_moo_b_init) return 0;
+  if (!_moo_b_valid_data) return 0;
+  if (!p_stems || frames <= 0) return 0;
+
+  if (mode == pxtnSTEM_unit && !_moo_AllocStems()) return 0;
+
+  int32_t stem_num = moo_stem_num(mode);
+  int32_t smp_w = 0;
+
+  _moo_b_stem_units = mode == pxtnSTEM_unit;
+  if (_moo_b_stem_units) {
+    for (int32_t u = 0; u < _unit_num; u++) _moo_stem_units[u] = u;
+    _moo_stem_num = _unit_num;
+  }
+  while (!_moo_b_end_vomit && smp_w < frames) {
+    int32_t blk_num = frames - smp_w;
+    if (blk_num > _MOO_BLOCK) blk_num = _MOO_BLOCK;
+    pxtnTRACE_SCOPE("moo_block", blk_num);
+
+    bool b_end = false;
+    int32_t num = _moo_PXTONE_BLOCK(blk_num, &b_end);
+    if (p_mix)
+      _moo_PXTONE_MIX((uint8_t*)p_mix + smp_w * _dst_byte_per_smp, num);
+    else
+      _moo_PXTONE_EFFECTS(num);
+
+    for (int32_t s = 0; s < stem_num; s++) {
+      void* p_dst = (uint8_t*)p_stems[s] + smp_w * _dst_byte_per_smp;
+      for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+        const int32_t* p_src =
+            mode == pxtnSTEM_unit
+                ? &_moo_stem_blks[(s * pxtnMAX_CHANNEL + ch) * _MOO_BLOCK]
+                : &_moo_group_blks[(ch * _group_num + s) * _MOO_BLOCK];
+        _moo_PXTONE_OUT(p_dst, ch, p_src, num);
+      }
+    }
+    smp_w += num;
+
+    if (b_end) _moo_b_end_vomit = true;
+  }
+  _moo_b_stem_units = false;
+
+  int32_t rest = (frames - smp_w) * _dst_byte_per_smp;
+  for (int32_t s = 0; s < stem_num; s++)
+    memset((uint8_t*)p_stems[s] + smp_w * _dst_byte_per_smp, 0, rest);
+  if (p_mix) memset((uint8_t*)p_mix + smp_w * _dst_byte_per_smp, 0, rest);
+
+  if (smp_w && _sampled_proc) {
+    if (!_sampled_proc(_sampled_user, this)) _moo_b_end_vomit = true;
+  }
+  return smp_w;
+}
+
+int32_t pxtnService::Moo_units(const uint8_t* p_mask, int32_t* const* p_units,
+                               uint8_t* const* p_groups, int32_t frames) {
+  if (!_moo_b_init) return 0;
+  if (!_moo_b_valid_data) return 0;
+  if (!p_mask || !p_units || !p_groups || frames <= 0) return 0;
+
+  if (!_moo_AllocStems()) return 0;
+
+  // only the masked units are captured; the others are left as they are and
+  // never woken.
+  _moo_unit_mask = p_mask;
+  _moo_stem_num = 0;
+  _moo_active_num = 0;
+  for (int32_t u = 0; u < _unit_num; u++) {
+    if (!p_mask[u]) {
+      _units[u]->set_moo_active(false);
+      continue;
+    }
+    _moo_stem_units[_moo_stem_num++] = u;
+    if (_units[u]->get_moo_active())
+      _moo_active_units[_moo_active_num++] = _units[u];
+  }
+
+  int32_t smp_w = 0;
+
+  _moo_b_stem_units = true;
+  while (!_moo_b_end_vomit && smp_w < frames) {
+    int32_t blk_num = frames - smp_w;
+    if (blk_num > _MOO_BLOCK) blk_num = _MOO_BLOCK;
+    pxtnTRACE_SCOPE("moo_block", blk_num);
+
+    bool b_end = false;
+    int32_t num = _moo_PXTONE_BLOCK(blk_num, &b_end);
+
+    for (int32_t i = 0; i < _moo_stem_num; i++) {
+      int32_t u = _moo_stem_units[i];
+      int32_t* p_dst = &p_units[u][smp_w * _dst_ch_num];
+      for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+        const int32_t* p_src =
+            &_moo_stem_blks[(u * pxtnMAX_CHANNEL + ch) * _MOO_BLOCK];
+        for (int32_t i = 0; i < num; i++) p_dst[i * _dst_ch_num + ch] = p_src[i];
+      }
+      memcpy(&p_groups[u][smp_w], &_moo_stem_grps[u * _MOO_BLOCK], num);
+    }
+    smp_w += num;
+
+    if (b_end) _moo_b_end_vomit = true;
+  }
+  _moo_b_stem_units = false;
+  _moo_unit_mask = NULL;
+
+  for (int32_t i = 0; i < _moo_stem_num; i++) {
+    int32_t u = _moo_stem_units[i];
+    memset(&p_units[u][smp_w * _dst_ch_num], 0,
+           sizeof(int32_t) * (frames - smp_w) * _dst_ch_num);
+    memset(&p_groups[u][smp_w], 0, frames - smp_w);
+  }
+  return smp_w;
+}
+
+int32_t pxtnService::Moo_mix_units(const int32_t* const* p_units,
+                                   const uint8_t* const* p_groups,
+                                   void* p_buf, int32_t frames) {
+  if (!_moo_b_init) return 0;
+  if (!_moo_b_valid_data) return 0;
+  if (!p_units || !p_groups || !p_buf || frames <= 0) return 0;
+
+  uint8_t* p8 = (uint8_t*)p_buf;
+  int32_t smp_w = 0;
+
+  while (!_moo_b_end_vomit && smp_w < frames) {
+    int32_t blk_num = frames - smp_w;
+    if (blk_num > _MOO_BLOCK) blk_num = _MOO_BLOCK;
+    pxtnTRACE_SCOPE("moo_block", blk_num);
+
+    // the frames and their fade, as _moo_PXTONE_TONES() would count them.
+    bool b_end = false;
+    int32_t num = 0;
+    while (num < blk_num) {
+      _moo_fade_blks[num] = _moo_fade_fade ? (_moo_fade_count >> 8) : -1;
+      if (!_moo_PXTONE_COUNT()) {
+        b_end = true;
+        break;
+      }
+      num++;
+    }
+
+    memset(_moo_group_blks, 0,
+           sizeof(int32_t) * _group_num * pxtnMAX_CHANNEL * _MOO_BLOCK);
+    for (int32_t u = 0; u < _unit_num; u++) {
+      if (!p_units[u]) continue;
+      const int32_t* p_src = &p_units[u][smp_w * _dst_ch_num];
+      const uint8_t* p_grp = &p_groups[u][smp_w];
+      for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
+        int32_t* p_blk = &_moo_group_blks[ch * _group_num * _MOO_BLOCK];
+        for (int32_t i = 0; i < num; i++)
+          p_blk[p_grp[i] * _MOO_BLOCK + i] += p_src[i * _dst_ch_num + ch];
+      }
+    }
+
+    _moo_PXTONE_MIX(p8, num);
+    p8 += num * _dst_byte_per_smp;
+    smp_w += num;
+
+    if (b_end) _moo_b_end_vomit = true;
+  }
+  memset(p8, 0, (frames - smp_w) * _dst_byte_per_smp);
+
+  if (smp_w && _sampled_proc) {
+    if (!_sampled_proc(_sampled_user, this)) _moo_b_end_vomit = true;
+  }
+  return smp_w;
+}
+
 int32_t pxtnService_moo_CalcSampleNum(int32_t meas_num, int32_t beat_num,
                                       int32_t sps, float beat_tempo) {
   uint32_t total_beat_num;
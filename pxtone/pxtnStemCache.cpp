@@ -0,0 +1,171 @@
+
+#include "./pxtnStemCache.h"
+
+#include "./pxtn.h"
+
+pxtnStemCache::pxtnStemCache(pxtnService* pxtn)
+    : _pxtn(pxtn), _smp_num(0), _ch_num(0), _render_unit_num(0) {
+  memset(&_prep, 0, sizeof(pxtnVOMITPREPARATION));
+}
+
+pxtnStemCache::~pxtnStemCache() { Release(); }
+
+void pxtnStemCache::Release() {
+  _smp_num = 0;
+  _ch_num = 0;
+  _render_unit_num = 0;
+  _dirty.clear();
+  _smps.clear();
+  _groups.clear();
+  _events.clear();
+}
+
+pxtnERR pxtnStemCache::Build(const pxtnVOMITPREPARATION* p_prep,
+                             int32_t smp_num) {
+  Release();
+  if (!_pxtn) return pxtnERR_INIT;
+  if (smp_num <= 0) return pxtnERR_param;
+
+  memset(&_prep, 0, sizeof(pxtnVOMITPREPARATION));
+  if (p_prep) _prep = *p_prep;
+  try {
+    _dirty.assign(_pxtn->Unit_Num(), 1);
+  } catch (const std::bad_alloc&) {
+    return pxtnERR_memory;
+  }
+  _smp_num = smp_num;
+  return pxtnOK;
+}
+
+void pxtnStemCache::Dirty_Unit(int32_t u) {
+  if (u >= 0 && u < (int32_t)_dirty.size()) _dirty[u] = 1;
+}
+
+// units that play woice 'w': by their voice events, or the default voice
+// until their first one.
+void pxtnStemCache::Dirty_Woice(int32_t w) {
+  int32_t unit_num = (int32_t)_dirty.size();
+  _Vector<int32_t, pxtnMEM_event> voice_clock;
+  try {
+    voice_clock.assign(unit_num, -1);
+  } catch (const std::bad_alloc&) {
+    for (int32_t u = 0; u < unit_num; u++) _dirty[u] = 1;
+    return;
+  }
+  for (const EVERECORD* p = _pxtn->evels->get_Records(); p; p = p->next) {
+    if (p->unit_no >= unit_num) continue;
+    if (p->kind == EVENTKIND_VOICENO) {
+      if (voice_clock[p->unit_no] < 0) voice_clock[p->unit_no] = p->clock;
+      if (p->value == w) _dirty[p->unit_no] = 1;
+    } else if (p->kind == EVENTKIND_ON && w == EVENTDEFAULT_VOICENO) {
+      if (voice_clock[p->unit_no] < 0 || p->clock <= voice_clock[p->unit_no])
+        _dirty[p->unit_no] = 1;
+    }
+  }
+}
+
+// keeps the size, so it does not allocate; Render() resizes.
+void pxtnStemCache::Dirty_All() {
+  for (size_t u = 0; u < _dirty.size(); u++) _dirty[u] = 1;
+}
+
+// units whose events differ from the last render.
+void pxtnStemCache::_DirtyEvents() {
+  int32_t unit_num = (int32_t)_dirty.size();
+  _Vector<size_t, pxtnMEM_event> pos(unit_num, 0);
+  for (const EVERECORD* p = _pxtn->evels->get_Records(); p; p = p->next) {
+    int32_t u = p->unit_no;
+    if (u >= unit_num) continue;
+    if (_dirty[u]) continue;
+    const _EVENTS& events = _events[u];
+    size_t i = pos[u]++;
+    if (i >= events.size() || events[i].kind != p->kind ||
+        events[i].value != p->value || events[i].clock != p->clock)
+      _dirty[u] = 1;
+  }
+  for (int32_t u = 0; u < unit_num; u++) {
+    if (!_dirty[u] && pos[u] != _events[u].size()) _dirty[u] = 1;
+  }
+}
+
+void pxtnStemCache::_KeepEvents() {
+  int32_t unit_num = (int32_t)_dirty.size();
+  _events.assign(unit_num, _EVENTS());
+  for (const EVERECORD* p = _pxtn->evels->get_Records(); p; p = p->next) {
+    if (p->unit_no >= unit_num) continue;
+    _EVENT e = {p->kind, p->value, p->clock};
+    _events[p->unit_no].push_back(e);
+  }
+}
+
+pxtnERR pxtnStemCache::Render(void* p_buf, int32_t size) {
+  try {
+    return _Render(p_buf, size);
+  } catch (const std::bad_alloc&) {
+    return pxtnERR_memory;
+  }
+}
+
+pxtnERR pxtnStemCache::_Render(void* p_buf, int32_t size) {
+  if (!_pxtn || !_smp_num) return pxtnERR_INIT;
+
+  int32_t ch_num = 0;
+  int32_t sps = 0;
+  pxtnDSTFORMAT format = pxtnDSTFORMAT_int16;
+  _pxtn->get_destination_quality(&ch_num, &sps, &format);
+  int32_t frame_size = ch_num * (format == pxtnDSTFORMAT_int16 ? 2 : 4);
+  if (!p_buf || !frame_size || size != _smp_num * frame_size)
+    return pxtnERR_param;
+
+  int32_t unit_num = _pxtn->Unit_Num();
+  if (unit_num != (int32_t)_dirty.size() || ch_num != _ch_num) {
+    // _dirty last, so a throw here leaves the sizes mismatched for next time.
+    _smps.assign(unit_num, _SMPS());
+    _groups.assign(unit_num, _GROUPS());
+    _dirty.assign(unit_num, 1);
+    _ch_num = ch_num;
+  } else {
+    _DirtyEvents();
+  }
+
+  _Vector<int32_t*> p_smps(unit_num, (int32_t*)NULL);
+  _Vector<uint8_t*> p_groups(unit_num, (uint8_t*)NULL);
+  _render_unit_num = 0;
+  for (int32_t u = 0; u < unit_num; u++) {
+    if (!_dirty[u]) continue;
+    _smps[u].resize((size_t)_smp_num * _ch_num);
+    _groups[u].resize(_smp_num);
+    p_smps[u] = _smps[u].data();
+    p_groups[u] = _groups[u].data();
+    _render_unit_num++;
+  }
+
+  // fewer frames than asked for are only right past the end of the song.
+  if (_render_unit_num) {
+    if (!_pxtn->moo_preparation(&_prep)) return pxtnERR_moo_init;
+    if (_pxtn->Moo_units(_dirty.data(), p_smps.data(), p_groups.data(),
+                         _smp_num) != _smp_num &&
+        !_pxtn->moo_is_end_vomit())
+      return _pxtn->moo_is_valid_data() ? pxtnERR_memory : pxtnERR_moo_init;
+    _KeepEvents();
+    _dirty.assign(unit_num, 0);
+  }
+
+  _Vector<const int32_t*> p_units(unit_num);
+  _Vector<const uint8_t*> p_grps(unit_num);
+  for (int32_t u = 0; u < unit_num; u++) {
+    p_units[u] = _smps[u].data();
+    p_grps[u] = _groups[u].data();
+  }
+
+  if (!_pxtn->moo_preparation(&_prep)) return pxtnERR_moo_init;
+  if (_pxtn->Moo_mix_units(p_units.data(), p_grps.data(), p_buf, _smp_num) !=
+          _smp_num &&
+      !_pxtn->moo_is_end_vomit())
+    return pxtnERR_moo_init;
+  return pxtnOK;
+}
+
+int32_t pxtnStemCache::get_smp_num() const { return _smp_num; }
+
+int32_t pxtnStemCache::get_render_unit_num() const { return _render_unit_num; }
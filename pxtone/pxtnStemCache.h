@@ -0,0 +1,72 @@
+#ifndef pxtnStemCache_H
+#define pxtnStemCache_H
+
+#include <vector>
+
+#include "./pxtnMem.h"
+#include "./pxtnService.h"
+
+// a render kept as what each unit adds to its group, for editors. after an
+// edit only the units it touches are rendered again; the groups, effects,
+// fade and master volume run over the kept units for the rest.
+//
+// units whose events changed are found by Render() itself. tell it about
+// the rest: Dirty_Woice() after Woice_ReadyTone(), Dirty_Unit() after unit
+// settings, Dirty_All() after anything else (master, effects, woice order,
+// destination quality).
+class pxtnStemCache {
+ public:
+  explicit pxtnStemCache(pxtnService* pxtn);
+  ~pxtnStemCache();
+
+  // 'smp_num' frames from p_prep (which may be NULL), every unit dirty.
+  // memory: smp_num * (channels * 4 + 1) bytes per unit.
+  pxtnERR Build(const pxtnVOMITPREPARATION* p_prep, int32_t smp_num);
+  void Release();
+
+  void Dirty_Unit(int32_t u);
+  void Dirty_Woice(int32_t w);
+  void Dirty_All();
+
+  // renders the dirty units again and the mix into 'size' bytes of p_buf,
+  // as Moo() from moo_preparation(p_prep). the service is left prepared.
+  // on failure the dirty units stay dirty for the next call.
+  pxtnERR Render(void* p_buf, int32_t size);
+
+  int32_t get_smp_num() const;
+  int32_t get_render_unit_num() const;  // by the last Render().
+
+ private:
+  pxtnStemCache(const pxtnStemCache& src);
+  void operator=(const pxtnStemCache& src);
+
+  template <class T, pxtnMEMKIND kind = pxtnMEM_moo>
+  using _Vector = std::vector<T, pxtnMemAllocator<T, kind> >;
+
+  typedef struct {
+    uint8_t kind;
+    int32_t value;
+    int32_t clock;
+  } _EVENT;
+  typedef _Vector<int32_t> _SMPS;
+  typedef _Vector<uint8_t> _GROUPS;
+  typedef _Vector<_EVENT, pxtnMEM_event> _EVENTS;
+
+  void _DirtyEvents();
+  void _KeepEvents();
+  // Render() without catching std::bad_alloc.
+  pxtnERR _Render(void* p_buf, int32_t size);
+
+  pxtnService* _pxtn;
+  pxtnVOMITPREPARATION _prep;
+  int32_t _smp_num;
+  int32_t _ch_num;
+  int32_t _render_unit_num;
+
+  _Vector<uint8_t> _dirty;
+  _Vector<_SMPS> _smps;                      // [unit][frame * ch + ch]
+  _Vector<_GROUPS> _groups;                  // [unit][frame]
+  _Vector<_EVENTS, pxtnMEM_event> _events;  // [unit], at the last render.
+};
+
+#endif
@@ -1,6 +1,7 @@
 ﻿// '12/03/03
 
 #include "./pxtn.h"
+#include "./pxtnMem.h"
 
 #include "./pxtnText.h"
 
@@ -13,7 +14,7 @@ bool pxtnText::_read4_malloc( char **pp, int32_t* p_buf_size, void* desc )
 
 	bool b_ret  = false;
 
-	if( !( *pp = (char *)malloc( *p_buf_size + 1 ) ) ) return false;
+	if( !( *pp = (char *)pxtnMem_alloc( *p_buf_size + 1, pxtnMEM_other ) ) ) return false;
 
 	memset( *pp, 0, *p_buf_size + 1 );
 
@@ -24,7 +25,7 @@ bool pxtnText::_read4_malloc( char **pp, int32_t* p_buf_size, void* desc )
 
 	b_ret = true;
 term:
-	if( !b_ret ){ free( *pp ); *pp = NULL; }
+	if( !b_ret ) pxtnMem_free( (void**)pp );
 
 	return b_ret;
 }
@@ -40,9 +41,9 @@ bool pxtnText::_write4( const char *p, int32_t buf_size, void* desc ) const
 bool pxtnText::set_name_buf( const char *name, int32_t buf_size )
 {
 	if( !name    ) return false;
-	if( _p_name_buf ) free( _p_name_buf ); _p_name_buf = NULL;
+	pxtnMem_free( (void**)&_p_name_buf );
 	if( buf_size <= 0 ){ _name_size = 0; return true; }
-	if( !(  _p_name_buf = (char *)malloc( buf_size + 1 ) ) ) return false;
+	if( !(  _p_name_buf = (char *)pxtnMem_alloc( buf_size + 1, pxtnMEM_other ) ) ) return false;
 	memcpy( _p_name_buf, name   ,         buf_size );
 	_p_name_buf[ buf_size ] = '\0';
 	_name_size = buf_size;
@@ -52,9 +53,9 @@ bool pxtnText::set_name_buf( const char *name, int32_t buf_size )
 bool pxtnText::set_comment_buf( const char *comment, int32_t buf_size )
 {
 	if( !comment ) return false;
-	if( _p_comment_buf ) free( _p_comment_buf ); _p_comment_buf = NULL;
+	pxtnMem_free( (void**)&_p_comment_buf );
 	if( buf_size <= 0 ){ _comment_size = 0; return true; }
-	if( !(  _p_comment_buf = (char *)malloc( buf_size + 1 ) ) ) return false;
+	if( !(  _p_comment_buf = (char *)pxtnMem_alloc( buf_size + 1, pxtnMEM_other ) ) ) return false;
 	memcpy( _p_comment_buf, comment,         buf_size );
 	_p_comment_buf[ buf_size ] = '\0';
 	_comment_size = buf_size;
@@ -87,8 +88,8 @@ pxtnText::pxtnText( pxtnIO_r io_read, pxtnIO_w io_write, pxtnIO_seek io_seek, px
 
 pxtnText::~pxtnText()
 {
-	if( _p_comment_buf ) free( _p_comment_buf ); _p_comment_buf = NULL; _comment_size = 0;
-	if( _p_name_buf    ) free( _p_name_buf    ); _p_name_buf    = NULL; _name_size    = 0;
+	pxtnMem_free( (void**)&_p_comment_buf ); _comment_size = 0;
+	pxtnMem_free( (void**)&_p_name_buf    ); _name_size    = 0;
 }
 
 
@@ -0,0 +1,92 @@
+
+#include "./pxtnTrace.h"
+
+#ifdef pxtnTRACE
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+typedef struct {
+  const char* name;
+  int32_t arg;
+  int64_t start_ns;
+  int64_t dur_ns;
+} _TRACESPAN;
+
+// one per thread that has recorded; only that thread appends to it, so
+// recording takes no lock. the list of them only grows.
+typedef struct _TRACEBUF {
+  std::vector<_TRACESPAN> spans;
+  const char* thread_name;
+  int32_t tid;
+  _TRACEBUF* next;
+} _TRACEBUF;
+
+static std::atomic<bool> _b_enabled(false);
+static std::atomic<_TRACEBUF*> _bufs(NULL);
+static std::atomic<int32_t> _tid_next(1);
+static thread_local _TRACEBUF* _p_buf = NULL;
+static const std::chrono::steady_clock::time_point _epoch =
+    std::chrono::steady_clock::now();
+
+static _TRACEBUF* _Buf() {
+  if (_p_buf) return _p_buf;
+  _TRACEBUF* p = new _TRACEBUF();
+  p->thread_name = NULL;
+  p->tid = _tid_next++;
+  p->next = _bufs.load();
+  while (!_bufs.compare_exchange_weak(p->next, p)) {
+  }
+  _p_buf = p;
+  return p;
+}
+
+void pxtnTrace_Enable(bool b) { _b_enabled.store(b); }
+
+bool pxtnTrace_IsEnabled() {
+  return _b_enabled.load(std::memory_order_relaxed);
+}
+
+int64_t pxtnTrace_Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - _epoch)
+      .count();
+}
+
+void pxtnTrace_ThreadName(const char* name) { _Buf()->thread_name = name; }
+
+void pxtnTrace_Span(const char* name, int32_t arg, int64_t start_ns) {
+  _TRACESPAN span = {name, arg, start_ns, pxtnTrace_Now() - start_ns};
+  _Buf()->spans.push_back(span);
+}
+
+bool pxtnTrace_Write(FILE* fp) {
+  if (!fp) return false;
+  bool b_first = true;
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  for (_TRACEBUF* p = _bufs.load(); p; p = p->next) {
+    if (p->thread_name) {
+      fprintf(fp,
+              "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+              "\"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+              b_first ? "" : ",", p->tid, p->thread_name);
+      b_first = false;
+    }
+    for (const _TRACESPAN& span : p->spans) {
+      fprintf(fp,
+              "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+              "\"ts\": %.3f, \"dur\": %.3f",
+              b_first ? "" : ",", span.name, p->tid, span.start_ns / 1000.0,
+              span.dur_ns / 1000.0);
+      if (span.arg >= 0) fprintf(fp, ", \"args\": {\"n\": %d}", span.arg);
+      fprintf(fp, "}");
+      b_first = false;
+    }
+    p->spans.clear();
+  }
+  fprintf(fp, "\n]}\n");
+  return !ferror(fp);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef pxtnTrace_H
+#define pxtnTrace_H
+
+// begin/end spans of the stages of each thread, flushed as chrome
+// trace_event json. recorded only when built with pxtnTRACE defined
+// (cmake -DPXTONE_TRACE=ON); otherwise the macros expand to nothing.
+
+#ifdef pxtnTRACE
+
+#include <cstdint>
+#include <cstdio>
+
+// spans are kept only while enabled; off at start.
+void pxtnTrace_Enable(bool b);
+bool pxtnTrace_IsEnabled();
+int64_t pxtnTrace_Now();  // ns.
+
+// 'name' is kept as the pointer, so it must be a literal.
+void pxtnTrace_ThreadName(const char* name);
+// arg < 0: none.
+void pxtnTrace_Span(const char* name, int32_t arg, int64_t start_ns);
+
+// every thread's spans as one json document, then forgets them. call it
+// once the traced threads have stopped.
+bool pxtnTrace_Write(FILE* fp);
+
+class pxtnTraceScope {
+ public:
+  pxtnTraceScope(const char* name, int32_t arg)
+      : _name(pxtnTrace_IsEnabled() ? name : NULL),
+        _arg(arg),
+        _start_ns(_name ? pxtnTrace_Now() : 0) {}
+  ~pxtnTraceScope() {
+    if (_name) pxtnTrace_Span(_name, _arg, _start_ns);
+  }
+
+ private:
+  const char* _name;
+  int32_t _arg;
+  int64_t _start_ns;
+};
+
+#define pxtnTRACE_CAT_(a, b) a##b
+#define pxtnTRACE_CAT(a, b) pxtnTRACE_CAT_(a, b)
+// a span from here to the end of the enclosing block.
+#define pxtnTRACE_SCOPE(name, arg) \
+  pxtnTraceScope pxtnTRACE_CAT(_trace_scope_, __LINE__)(name, arg)
+#define pxtnTRACE_THREAD(name) pxtnTrace_ThreadName(name)
+
+#else
+
+#define pxtnTRACE_SCOPE(name, arg)
+#define pxtnTRACE_THREAD(name)
+
+#endif
+
+#endif
@@ -12,6 +12,18 @@ pxtnUnit::pxtnUnit( pxtnIO_r io_read, pxtnIO_w io_write, pxtnIO_seek io_seek, px
 	_bOperated = true;
 	strcpy( _name_buf, "no name" );
 	_name_size = strlen( _name_buf );
+
+	_silent_count  =     0;
+	_b_moo_active  = false;
+	_moo_tick_num  =     0;
+	_moo_frame_num =     0;
+
+	_b_pitch_dirty = true ;
+	_pitch_step    =     0;
+
+	_b_fixed_phase = false;
+	_b_fixed_dirty = true ;
+	_fixed_freq    =     0;
 }
 
 pxtnUnit::~pxtnUnit()
@@ -26,6 +38,7 @@ void pxtnUnit::Tone_Init()
 	_v_TUNING             = EVENTDEFAULT_TUNING  ;
 	_portament_sample_num =                     0;
 	_portament_sample_pos =                     0;
+	_b_pitch_dirty        =                  true;
 
 	for( int32_t i = 0; i < pxtnMAX_CHANNEL; i++ )
 	{
@@ -37,6 +50,7 @@ void pxtnUnit::Tone_Init()
 void pxtnUnit::Tone_Clear()
 {
 	for( int32_t i = 0; i < pxtnMAX_CHANNEL; i++ ) memset( _pan_time_bufs[ i ], 0, sizeof(int ) * pxtnBUFSIZE_TIMEPAN );
+	_silent_count = pxtnBUFSIZE_TIMEPAN;
 }
 
 void pxtnUnit::Tone_Reset_and_2prm( int32_t voice_idx, int32_t env_rls_clock, float offset_freq )
@@ -45,9 +59,11 @@ void pxtnUnit::Tone_Reset_and_2prm( int32_t voice_idx, int32_t env_rls_clock, fl
 	p_tone->life_count    = 0;
 	p_tone->on_count      = 0;
 	p_tone->smp_pos       = 0;
+	p_tone->smp_pos_fx    = 0;
 	p_tone->smooth_volume = 0;
 	p_tone->env_release_clock = env_rls_clock;
 	p_tone->offset_freq       = offset_freq  ;
+	_b_fixed_dirty = true;
 }
 
 bool pxtnUnit::set_woice( const pxtnWoice *p_woice )
@@ -57,6 +73,7 @@ bool pxtnUnit::set_woice( const pxtnWoice *p_woice )
 	_key_now    = EVENTDEFAULT_KEY;
 	_key_margin = 0;
 	_key_start  = EVENTDEFAULT_KEY;
+	_b_pitch_dirty = true;
 	return true;
 }
 
@@ -91,6 +108,24 @@ void pxtnUnit::set_played  ( bool b )
 bool pxtnUnit::get_operated() const{ return _bOperated; }
 bool pxtnUnit::get_played  () const{ return _bPlayed  ; }
 
+void pxtnUnit::set_moo_active( bool b ){ _b_moo_active = b; }
+bool pxtnUnit::get_moo_active() const{ return _b_moo_active; }
+
+void pxtnUnit::add_moo_cost( int64_t tick_num, int32_t frame_num )
+{
+	_moo_tick_num  += tick_num ;
+	_moo_frame_num += frame_num;
+}
+
+int64_t pxtnUnit::take_moo_cost( int32_t* p_frame_num )
+{
+	int64_t tick_num = _moo_tick_num;
+	*p_frame_num   = _moo_frame_num;
+	_moo_tick_num  = 0;
+	_moo_frame_num = 0;
+	return tick_num;
+}
+
 void pxtnUnit::Tone_ZeroLives()
 {
 	for( int32_t i = 0; i < pxtnMAX_CHANNEL; i++ ) _vts[ i ].life_count = 0;
@@ -101,6 +136,7 @@ void pxtnUnit::Tone_KeyOn()
 	_key_now    = _key_start + _key_margin;
 	_key_start  = _key_now;
 	_key_margin = 0;
+	_b_pitch_dirty = true;
 }
 
 void pxtnUnit::Tone_Key( int32_t  key )
@@ -108,6 +144,7 @@ void pxtnUnit::Tone_Key( int32_t  key )
 	_key_start            = _key_now;
 	_key_margin           = key - _key_start;
 	_portament_sample_pos = 0;
+	_b_pitch_dirty        = true;
 }
 
 void pxtnUnit::Tone_Pan_Volume( int32_t ch, int32_t  pan )
@@ -143,46 +180,72 @@ void pxtnUnit::Tone_Pan_Time( int32_t ch, int32_t  pan, int32_t sps )
 
 void pxtnUnit::Tone_Velocity ( int32_t val ){ _v_VELOCITY           = val; }
 void pxtnUnit::Tone_Volume   ( int32_t val ){ _v_VOLUME             = val; }
-void pxtnUnit::Tone_Portament( int32_t val ){ _portament_sample_num = val; }
+void pxtnUnit::Tone_Portament( int32_t val ){ _portament_sample_num = val; _b_pitch_dirty = true; }
 void pxtnUnit::Tone_GroupNo  ( int32_t val ){ _v_GROUPNO            = val; }
-void pxtnUnit::Tone_Tuning   ( float   val ){ _v_TUNING             = val; }
+void pxtnUnit::Tone_Tuning   ( float   val ){ _v_TUNING             = val; _b_fixed_dirty = true; _b_pitch_dirty = true; }
 
-void pxtnUnit::Tone_Envelope()
+// playback position as 32.32 fixed point. the step is only rebuilt when freq, tuning or voice change.
+void pxtnUnit::Tone_FixedPhase( bool b ){ _b_fixed_phase = b; _b_fixed_dirty = true; }
+
+void pxtnUnit::_Envelope_Voice( int32_t v )
 {
-	if( !_p_woice ) return;
+	const pxtnVOICEINSTANCE *p_vi = _p_woice->get_instance( v );
+	pxtnVOICETONE           *p_vt = &_vts                 [ v ];
 
-	for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ )
+	if( p_vt->life_count > 0 && p_vi->env_size )
 	{
-		const pxtnVOICEINSTANCE *p_vi = _p_woice->get_instance( v );
-		pxtnVOICETONE           *p_vt = &_vts                 [ v ];
-
-		if( p_vt->life_count > 0 && p_vi->env_size )
+		if( p_vt->on_count > 0 )
 		{
-			if( p_vt->on_count > 0 )
+			if( p_vt->env_pos < p_vi->env_size )
 			{
-				if( p_vt->env_pos < p_vi->env_size )
+				if( p_vi->p_env )
 				{
 					p_vt->env_volume = p_vi->p_env[ p_vt->env_pos ];
-					p_vt->env_pos++;
 				}
-			}
-			// release.
-			else
-			{
-				p_vt->env_volume = p_vt->env_start + ( 0 - p_vt->env_start ) * p_vt->env_pos / p_vi->env_release;
+				else
+				{
+					const pxtnVOICEENVSEGMENT* p_seg = &p_vi->p_env_seg[ p_vt->env_seg ];
+					while( p_vt->env_pos >= p_seg->smp_end && p_vt->env_seg < p_vi->env_seg_num - 1 )
+					{
+						p_seg = &p_vi->p_env_seg[ ++p_vt->env_seg ];
+						p_vt->env_quo = p_seg->init_q;
+						p_vt->env_rem = p_seg->init_r;
+					}
+					p_vt->env_volume = (uint8_t)( p_seg->y + p_vt->env_quo );
+					p_vt->env_quo   += p_seg->step_q;
+					p_vt->env_rem   += p_seg->step_r;
+					if( p_vt->env_rem >= p_seg->dx ){ p_vt->env_rem -= p_seg->dx; p_vt->env_quo += p_seg->carry; }
+				}
 				p_vt->env_pos++;
 			}
 		}
+		// release.
+		else
+		{
+			p_vt->env_volume = p_vt->env_start + ( 0 - p_vt->env_start ) * p_vt->env_pos / p_vi->env_release;
+			p_vt->env_pos++;
+		}
 	}
 }
 
-void pxtnUnit::Tone_Sample( bool b_mute_by_unit, int32_t ch_num, int32_t  time_pan_index, int32_t  smooth_smp )
+void pxtnUnit::Tone_Envelope()
+{
+	if( !_p_woice ) return;
+	for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ ) _Envelope_Voice( v );
+}
+
+// channels without time-pan go straight to group_smps[ ch ]; the ring is still written
+// so a later EVENTKIND_PAN_TIME reads the right history.
+void pxtnUnit::Tone_Sample( bool b_mute_by_unit, int32_t ch_num, int32_t  time_pan_index, int32_t  smooth_smp, int32_t **group_smps )
 {
 	if( !_p_woice ) return;
 
+	bool b_live = false;
+
 	if( b_mute_by_unit && !_bPlayed )
 	{
 		for( int32_t ch = 0; ch < ch_num; ch++ ) _pan_time_bufs[ ch ][ time_pan_index ] = 0;
+		if( _silent_count < pxtnBUFSIZE_TIMEPAN ) _silent_count++;
 		return;
 	}
 
@@ -199,7 +262,9 @@ void pxtnUnit::Tone_Sample( bool b_mute_by_unit, int32_t ch_num, int32_t  time_p
 
 			if( p_vt->life_count > 0 )
             {
-                int32_t pos = (int32_t)trunc(p_vt->smp_pos) * 4 + ch * 2;
+				b_live = true;
+
+                int32_t pos = ( _b_fixed_phase ? (int32_t)( p_vt->smp_pos_fx >> 32 ) : (int32_t)trunc(p_vt->smp_pos) ) * 4 + ch * 2;
 				work += *( (short*)&p_vi->p_smp_w[ pos ] );
 
 				if( ch_num == 1 )
@@ -223,15 +288,32 @@ void pxtnUnit::Tone_Sample( bool b_mute_by_unit, int32_t ch_num, int32_t  time_p
 			time_pan_buf += work;
 		}
 		_pan_time_bufs[ ch ][ time_pan_index ] = time_pan_buf;
+		if( ch < ch_num && !_pan_times[ ch ] ) group_smps[ ch ][ _v_GROUPNO ] += time_pan_buf;
 	}
+
+	if     ( b_live                               ) _silent_count = 0;
+	else if( _silent_count < pxtnBUFSIZE_TIMEPAN ) _silent_count++;
 }
 
 void pxtnUnit::Tone_Supple( int32_t  *group_smps, int32_t ch, int32_t  time_pan_index ) const
 {
+	if( !_pan_times[ ch ] ) return; // added by Tone_Sample.
 	int32_t  idx = ( time_pan_index - _pan_times[ ch ] ) & ( pxtnBUFSIZE_TIMEPAN - 1 );
 	group_smps[ _v_GROUPNO ] += _pan_time_bufs[ ch ][ idx ];
 }
 
+// what the unit adds to its group this frame, by Tone_Sample() or Tone_Supple().
+int32_t pxtnUnit::Tone_Supple_Get( int32_t ch, int32_t time_pan_index ) const
+{
+	return _pan_time_bufs[ ch ][ ( time_pan_index - _pan_times[ ch ] ) & ( pxtnBUFSIZE_TIMEPAN - 1 ) ];
+}
+
+// the group it adds to this frame.
+int32_t pxtnUnit::Tone_GroupNo_Get() const
+{
+	return _v_GROUPNO;
+}
+
 int  pxtnUnit::Tone_Increment_Key()
 {
 	// prtament..
@@ -256,20 +338,48 @@ int  pxtnUnit::Tone_Increment_Key()
 	return _key_now;
 }
 
-void pxtnUnit::Tone_Increment_Sample( float freq )
+// the key only moves on events or during a portament, so the table is skipped otherwise.
+float pxtnUnit::Tone_Increment_Pitch( pxtnPulse_Frequency *p_freq, float smp_stride )
 {
-	if( !_p_woice ) return;
+	if( _b_pitch_dirty )
+	{
+		_pitch_step    = p_freq->Get2( Tone_Increment_Key() ) * smp_stride;
+		_b_pitch_dirty = ( _portament_sample_num && _key_margin );
+	}
+	return _pitch_step;
+}
 
-	for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ )
+void pxtnUnit::_Increment_Voice( int32_t v, float freq )
+{
+	const pxtnVOICEINSTANCE* p_vi = _p_woice->get_instance( v );
+	pxtnVOICETONE*           p_vt = &_vts                 [ v ];
+
+	if( p_vt->life_count > 0 ) p_vt->life_count--;
+	if( p_vt->life_count > 0 )
 	{
-		const pxtnVOICEINSTANCE* p_vi = _p_woice->get_instance( v );
-		pxtnVOICETONE*           p_vt = &_vts                 [ v ];
+		p_vt->on_count--;
 
-		if( p_vt->life_count > 0 ) p_vt->life_count--;
-		if( p_vt->life_count > 0 )
+		if( _b_fixed_phase )
 		{
-			p_vt->on_count--;
+			int64_t body = (int64_t)p_vi->smp_body_w << 32;
+
+			p_vt->smp_pos_fx += p_vt->smp_step_fx;
 
+			if( p_vt->smp_pos_fx >= body )
+			{
+				if( _p_woice->get_voice( v )->voice_flags & PTV_VOICEFLAG_WAVELOOP )
+				{
+					if( p_vt->smp_pos_fx >= body ) p_vt->smp_pos_fx -= body;
+					if( p_vt->smp_pos_fx >= body ) p_vt->smp_pos_fx  = 0;
+				}
+				else
+				{
+					p_vt->life_count = 0;
+				}
+			}
+		}
+		else
+		{
 			p_vt->smp_pos += p_vt->offset_freq * _v_TUNING * freq;
 
 			if( p_vt->smp_pos >= p_vi->smp_body_w )
@@ -284,17 +394,228 @@ void pxtnUnit::Tone_Increment_Sample( float freq )
 					p_vt->life_count = 0;
 				}
 			}
+		}
+
+		// OFF
+		if( p_vt->on_count == 0 && p_vi->env_size )
+		{
+			p_vt->env_start = p_vt->env_volume;
+			p_vt->env_pos   = 0;
+		}
+	}
+}
+
+void pxtnUnit::Tone_Increment_Sample( float freq )
+{
+	if( !_p_woice ) return;
+
+	if( _b_fixed_phase && ( _b_fixed_dirty || freq != _fixed_freq ) )
+	{
+		for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ )
+		{
+			float step = _vts[ v ].offset_freq * _v_TUNING * freq;
+			_vts[ v ].smp_step_fx = (int64_t)( (double)step * 4294967296.0 );
+		}
+		_fixed_freq    = freq ;
+		_b_fixed_dirty = false;
+	}
+
+	for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ ) _Increment_Voice( v, freq );
+}
 
-			// OFF
-			if( p_vt->on_count == 0 && p_vi->env_size )
+// 'num' frames of the attack in one go. a segment step is quotient + remainder,
+// so after k steps the carries are ( rem + k * step_r ) / dx.
+static void _skip_attack( const pxtnVOICEINSTANCE* p_vi, pxtnVOICETONE* p_vt, int32_t num )
+{
+	if( p_vi->p_env )
+	{
+		p_vt->env_volume = p_vi->p_env[ p_vt->env_pos + num - 1 ];
+		p_vt->env_pos   += num;
+		return;
+	}
+
+	while( num > 0 )
+	{
+		const pxtnVOICEENVSEGMENT* p_seg = &p_vi->p_env_seg[ p_vt->env_seg ];
+		while( p_vt->env_pos >= p_seg->smp_end && p_vt->env_seg < p_vi->env_seg_num - 1 )
+		{
+			p_seg = &p_vi->p_env_seg[ ++p_vt->env_seg ];
+			p_vt->env_quo = p_seg->init_q;
+			p_vt->env_rem = p_seg->init_r;
+		}
+
+		int32_t k = p_seg->smp_end - p_vt->env_pos;
+		if( k < 1 || k > num ) k = num;
+
+		int64_t r_last = (int64_t)p_vt->env_rem + (int64_t)( k - 1 ) * p_seg->step_r;
+		int64_t r_end  = r_last + p_seg->step_r;
+		p_vt->env_volume = (uint8_t)( p_seg->y + p_vt->env_quo + ( k - 1 ) * p_seg->step_q + p_seg->carry * (int32_t)( r_last / p_seg->dx ) );
+		p_vt->env_quo   += k * p_seg->step_q + p_seg->carry * (int32_t)( r_end / p_seg->dx );
+		p_vt->env_rem    = (int32_t)( r_end % p_seg->dx );
+		p_vt->env_pos   += k;
+		num             -= k;
+	}
+}
+
+// _Envelope_Voice + _Increment_Voice for 'num' frames at a settled pitch; returns the
+// frames the voice was alive. stretches where neither the attack, the note nor the
+// life ends are done at once, the 32.32 phase in closed form.
+int32_t pxtnUnit::_Skip_Voice( int32_t v, int32_t num, float freq )
+{
+	const pxtnVOICEINSTANCE* p_vi   = _p_woice->get_instance( v );
+	pxtnVOICETONE*           p_vt   = &_vts                 [ v ];
+	bool                     b_loop = ( _p_woice->get_voice( v )->voice_flags & PTV_VOICEFLAG_WAVELOOP ) ? true : false;
+
+	int32_t live = 0;
+	while( live < num && p_vt->life_count > 0 )
+	{
+		bool b_attack  = p_vi->env_size && p_vt->on_count > 0 && p_vt->env_pos < p_vi->env_size;
+		bool b_release = p_vi->env_size && p_vt->on_count <= 0;
+
+		int32_t run = num - live;
+		if( run > p_vt->life_count - 1 ) run = p_vt->life_count - 1;
+		if( p_vi->env_size && p_vt->on_count > 0 && run > p_vt->on_count - 1 ) run = p_vt->on_count - 1;
+		if( b_attack && run > p_vi->env_size - p_vt->env_pos ) run = p_vi->env_size - p_vt->env_pos;
+
+		if( run < 1 ){ _Envelope_Voice( v ); _Increment_Voice( v, freq ); live++; continue; }
+
+		int32_t done   = 0;
+		bool    b_dead = false;
+
+		if( _b_fixed_phase )
+		{
+			int64_t body = (int64_t)p_vi->smp_body_w << 32;
+			int64_t step = p_vt->smp_step_fx;
+			int64_t pos  = p_vt->smp_pos_fx;
+
+			if( step > 0 && step < body && pos >= 0 && pos < body && run <= ( INT64_MAX - body ) / step )
 			{
-				p_vt->env_start = p_vt->env_volume;
-				p_vt->env_pos   = 0;
+				if( b_loop ){ pos = ( pos + step * run ) % body; done = run; }
+				else
+				{
+					int64_t die = ( body - pos + step - 1 ) / step;
+					if( die <= run ){ done = (int32_t)die; b_dead = true; }
+					else            { done = run; pos += step * run; }
+				}
 			}
+			else
+			{
+				while( done < run && !b_dead )
+				{
+					done++;
+					pos += step;
+					if( pos >= body )
+					{
+						if( b_loop ){ if( pos >= body ) pos -= body; if( pos >= body ) pos = 0; }
+						else        { b_dead = true; }
+					}
+				}
+			}
+			p_vt->smp_pos_fx = pos;
+		}
+		else
+		{
+			float  step = p_vt->offset_freq * _v_TUNING * freq;
+			double pos  = p_vt->smp_pos;
+			while( done < run && !b_dead )
+			{
+				done++;
+				pos += step;
+				if( pos >= p_vi->smp_body_w )
+				{
+					if( b_loop ){ if( pos >= p_vi->smp_body_w ) pos -= p_vi->smp_body_w; if( pos >= p_vi->smp_body_w ) pos = 0; }
+					else        { b_dead = true; }
+				}
+			}
+			p_vt->smp_pos = pos;
+		}
+
+		if( b_attack ) _skip_attack( p_vi, p_vt, done );
+		else if( b_release )
+		{
+			p_vt->env_volume = p_vt->env_start + ( 0 - p_vt->env_start ) * ( p_vt->env_pos + done - 1 ) / p_vi->env_release;
+			p_vt->env_pos   += done;
 		}
+		p_vt->on_count   -= done;
+		p_vt->life_count  = b_dead ? 0 : p_vt->life_count - done;
+		live += done;
+	}
+	return live;
+}
+
+// Tone_Sample without the output: only what decides Tone_Is_Idle() is kept.
+// the time-pan ring is left as is, a fast-forward renders its last frames;
+// once the unit falls silent it holds the zeros a render would have left.
+void pxtnUnit::Tone_Skip_Sample( bool b_mute_by_unit )
+{
+	if( !_p_woice ) return;
+
+	bool b_live = false;
+	if( !b_mute_by_unit || _bPlayed )
+	{
+		for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ ){ if( _vts[ v ].life_count > 0 ){ b_live = true; break; } }
+	}
+
+	if     ( b_live                               ) _silent_count = 0;
+	else if( _silent_count < pxtnBUFSIZE_TIMEPAN ){ _silent_count++; if( _silent_count == pxtnBUFSIZE_TIMEPAN ) memset( _pan_time_bufs, 0, sizeof(_pan_time_bufs) ); }
+}
+// 'num' frames with no event between them: envelope, state and pitch / phase.
+// once the pitch is settled the voices do not touch each other, so each one
+// runs the whole span alone.
+void pxtnUnit::Tone_Skip( int32_t num, bool b_mute_by_unit, pxtnPulse_Frequency *p_freq, float smp_stride )
+{
+	if( !_p_woice ) return;
+
+	int32_t i = 0;
+	for( ; i < num && ( i == 0 || _b_pitch_dirty ); i++ )
+	{
+		if( Tone_Is_Idle() ) return;
+		Tone_Envelope   ();
+		Tone_Skip_Sample( b_mute_by_unit );
+		Tone_Increment_Sample( Tone_Increment_Pitch( p_freq, smp_stride ) );
+	}
+	if( i == num ) return;
+
+	num -= i;
+	float   freq     = Tone_Increment_Pitch( p_freq, smp_stride );
+	int32_t live_max = 0;
+	for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ )
+	{
+		int32_t live = _Skip_Voice( v, num, freq );
+		if( live > live_max ) live_max = live;
+	}
+
+	if( b_mute_by_unit && !_bPlayed ) live_max = 0;
+	if( live_max == num ) _silent_count = 0;
+	else
+	{
+		if( live_max ) _silent_count = 0;
+		bool b_silent = _silent_count >= pxtnBUFSIZE_TIMEPAN;
+		_silent_count += num - live_max;
+		if( _silent_count > pxtnBUFSIZE_TIMEPAN ) _silent_count = pxtnBUFSIZE_TIMEPAN;
+		if( !b_silent && _silent_count == pxtnBUFSIZE_TIMEPAN ) memset( _pan_time_bufs, 0, sizeof(_pan_time_bufs) );
 	}
 }
 
+// nothing sounds, the time-pan ring has drained and the key is settled:
+// Tone_Envelope / Sample / Supple / Increment_* would only produce zeros.
+bool pxtnUnit::Tone_Is_Idle() const
+{
+	if( _silent_count < pxtnBUFSIZE_TIMEPAN || _b_pitch_dirty ) return false;
+	if( !_p_woice ) return true;
+	for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ ){ if( _vts[ v ].life_count > 0 ) return false; }
+	return true;
+}
+
+// nothing sounds and the time-pan ring has drained: the unit feeds only zeros.
+bool pxtnUnit::Tone_Is_Silent() const
+{
+	if( _silent_count < pxtnBUFSIZE_TIMEPAN ) return false;
+	if( !_p_woice ) return true;
+	for( int32_t v = 0; v < _p_woice->get_voice_num(); v++ ){ if( _vts[ v ].life_count > 0 ) return false; }
+	return true;
+}
+
 const pxtnWoice *pxtnUnit::get_woice() const{ return _p_woice; }
 
 pxtnVOICETONE *pxtnUnit::get_tone( int32_t voice_idx )
@@ -302,6 +623,54 @@ pxtnVOICETONE *pxtnUnit::get_tone( int32_t voice_idx )
 	return &_vts[ voice_idx ];
 }
 
+void pxtnUnit::Tone_State_Get( pxtnUNITTONESTATE* p ) const
+{
+	p->key_now              = _key_now             ;
+	p->key_start            = _key_start           ;
+	p->key_margin           = _key_margin          ;
+	p->portament_sample_pos = _portament_sample_pos;
+	p->portament_sample_num = _portament_sample_num;
+	memcpy( p->pan_vols     , _pan_vols     , sizeof(_pan_vols     ) );
+	memcpy( p->pan_times    , _pan_times    , sizeof(_pan_times    ) );
+	memcpy( p->pan_time_bufs, _pan_time_bufs, sizeof(_pan_time_bufs) );
+	p->v_VOLUME             = _v_VOLUME            ;
+	p->v_VELOCITY           = _v_VELOCITY          ;
+	p->v_GROUPNO            = _v_GROUPNO           ;
+	p->v_TUNING             = _v_TUNING            ;
+	p->silent_count         = _silent_count        ;
+	p->b_moo_active         = _b_moo_active        ;
+	p->b_pitch_dirty        = _b_pitch_dirty       ;
+	p->pitch_step           = _pitch_step          ;
+	p->b_fixed_dirty        = _b_fixed_dirty       ;
+	p->fixed_freq           = _fixed_freq          ;
+	p->p_woice              = _p_woice             ;
+	memcpy( p->vts          , _vts          , sizeof(_vts          ) );
+}
+
+void pxtnUnit::Tone_State_Set( const pxtnUNITTONESTATE* p )
+{
+	_key_now              = p->key_now             ;
+	_key_start            = p->key_start           ;
+	_key_margin           = p->key_margin          ;
+	_portament_sample_pos = p->portament_sample_pos;
+	_portament_sample_num = p->portament_sample_num;
+	memcpy( _pan_vols     , p->pan_vols     , sizeof(_pan_vols     ) );
+	memcpy( _pan_times    , p->pan_times    , sizeof(_pan_times    ) );
+	memcpy( _pan_time_bufs, p->pan_time_bufs, sizeof(_pan_time_bufs) );
+	_v_VOLUME             = p->v_VOLUME            ;
+	_v_VELOCITY           = p->v_VELOCITY          ;
+	_v_GROUPNO            = p->v_GROUPNO           ;
+	_v_TUNING             = p->v_TUNING            ;
+	_silent_count         = p->silent_count        ;
+	_b_moo_active         = p->b_moo_active        ;
+	_b_pitch_dirty        = p->b_pitch_dirty       ;
+	_pitch_step           = p->pitch_step          ;
+	_b_fixed_dirty        = p->b_fixed_dirty       ;
+	_fixed_freq           = p->fixed_freq          ;
+	_p_woice              = p->p_woice             ;
+	memcpy( _vts          , p->vts          , sizeof(_vts          ) );
+}
+
 
 // v1x (20byte) ================= 
 typedef struct
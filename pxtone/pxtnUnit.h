@@ -8,6 +8,32 @@
 #include "./pxtnMax.h"
 #include "./pxtnWoice.h"
 
+// mutable tone state of a unit, kept by render snapshots.
+typedef struct
+{
+	int32_t          key_now      ;
+	int32_t          key_start    ;
+	int32_t          key_margin   ;
+	int32_t          portament_sample_pos;
+	int32_t          portament_sample_num;
+	int32_t          pan_vols     [ pxtnMAX_CHANNEL ];
+	int32_t          pan_times    [ pxtnMAX_CHANNEL ];
+	int32_t          pan_time_bufs[ pxtnMAX_CHANNEL ][ pxtnBUFSIZE_TIMEPAN ];
+	int32_t          v_VOLUME     ;
+	int32_t          v_VELOCITY   ;
+	int32_t          v_GROUPNO    ;
+	float            v_TUNING     ;
+	int32_t          silent_count ;
+	bool             b_moo_active ;
+	bool             b_pitch_dirty;
+	float            pitch_step   ;
+	bool             b_fixed_dirty;
+	float            fixed_freq   ;
+	const pxtnWoice* p_woice      ;
+	pxtnVOICETONE    vts[ pxtnMAX_UNITCONTROLVOICE ];
+}
+pxtnUNITTONESTATE;
+
 class pxtnUnit: public pxtnData
 {
 private:
@@ -33,10 +59,26 @@ private:
 	int32_t  _v_GROUPNO ;
 	float    _v_TUNING  ;
 
+	int32_t  _silent_count ; // frames in a row that wrote only zeros to _pan_time_bufs.
+	bool     _b_moo_active ;
+	int64_t  _moo_tick_num ; // render cost counted while profiling, until taken.
+	int32_t  _moo_frame_num;
+
+	bool     _b_pitch_dirty;
+	float    _pitch_step   ;
+
+	bool     _b_fixed_phase;
+	bool     _b_fixed_dirty;
+	float    _fixed_freq   ;
+
 	const pxtnWoice *_p_woice;
 
 	pxtnVOICETONE _vts[ pxtnMAX_UNITCONTROLVOICE ];
 
+	void _Envelope_Voice ( int32_t v );
+	void _Increment_Voice( int32_t v, float freq );
+	int32_t _Skip_Voice  ( int32_t v, int32_t num, float freq );
+
 public :
 	 pxtnUnit( pxtnIO_r io_read, pxtnIO_w io_write, pxtnIO_seek io_seek, pxtnIO_pos io_pos );
 	~pxtnUnit();
@@ -58,11 +100,22 @@ public :
 	void    Tone_Portament ( int32_t val );
 	void    Tone_GroupNo   ( int32_t val );
 	void    Tone_Tuning    ( float   val );
+	void    Tone_FixedPhase( bool    b   );
 		    			   
-	void    Tone_Sample    ( bool b_mute_by_unit, int32_t ch_num, int32_t time_pan_index, int32_t smooth_smp );
+	void    Tone_Sample    ( bool b_mute_by_unit, int32_t ch_num, int32_t time_pan_index, int32_t smooth_smp, int32_t **group_smps );
 	void    Tone_Supple    ( int32_t *group_smps, int32_t ch_num, int32_t time_pan_index ) const;
+	int32_t Tone_Supple_Get( int32_t ch, int32_t time_pan_index ) const;
+	int32_t Tone_GroupNo_Get() const;
 	int32_t Tone_Increment_Key   ();
+	float   Tone_Increment_Pitch ( pxtnPulse_Frequency *p_freq, float smp_stride );
 	void    Tone_Increment_Sample( float freq );
+	bool    Tone_Is_Idle         () const;
+	bool    Tone_Is_Silent       () const;
+	void    Tone_Skip_Sample     ( bool b_mute_by_unit );
+	void    Tone_Skip            ( int32_t num, bool b_mute_by_unit, pxtnPulse_Frequency *p_freq, float smp_stride );
+
+	void    Tone_State_Get( pxtnUNITTONESTATE*       p_state ) const;
+	void    Tone_State_Set( const pxtnUNITTONESTATE* p_state );
 
 	bool             set_woice( const pxtnWoice *p_woice );
 	const pxtnWoice* get_woice() const;
@@ -78,6 +131,12 @@ public :
 	bool get_operated() const;
 	bool get_played  () const;
 
+	void set_moo_active( bool b );
+	bool get_moo_active() const;
+
+	void    add_moo_cost ( int64_t tick_num, int32_t frame_num );
+	int64_t take_moo_cost( int32_t* p_frame_num );
+
 	pxtnERR Read_v3x( void* desc, int32_t *p_group );
 	bool    Read_v1x( void* desc, int32_t *p_group );
 };
@@ -82,6 +82,7 @@ static void _Voice_Release( pxtnVOICEUNIT* p_vc, pxtnVOICEINSTANCE* p_vi )
 	if( p_vi )
 	{
 		pxtnMem_free( (void**)&p_vi->p_env           );
+		pxtnMem_free( (void**)&p_vi->p_env_seg       );
 		pxtnMem_free( (void**)&p_vi->p_smp_w         );
 		memset( p_vi, 0, sizeof(pxtnVOICEINSTANCE) );
 	}
@@ -185,7 +186,7 @@ bool pxtnWoice::Copy( pxtnWoice *p_dst ) const
 		p_vc2->envelope.tail_num = p_vc1->envelope.tail_num;
 		num  = p_vc2->envelope.head_num + p_vc2->envelope.body_num + p_vc2->envelope.tail_num;
 		size = sizeof(pxtnPOINT) * num;
-		if( !pxtnMem_zero_alloc( (void **)&p_vc2->envelope.points, size ) ) goto End;
+		if( !pxtnMem_zero_alloc( (void **)&p_vc2->envelope.points, size, pxtnMEM_envelope ) ) goto End;
 		memcpy(                            p_vc2->envelope.points, p_vc1->envelope.points, size );
 
 		// wave
@@ -269,7 +270,7 @@ term:
 }
 
 
-void pxtnWoice::_UpdateWavePTV( pxtnVOICEUNIT* p_vc, pxtnVOICEINSTANCE* p_vi, int32_t  ch, int32_t  sps, int32_t  bps )
+bool pxtnWoice::_UpdateWavePTV( pxtnVOICEUNIT* p_vc, pxtnVOICEINSTANCE* p_vi, int32_t  ch, int32_t  sps, int32_t  bps )
 {
 	double  work, osc;
 	int32_t long_;
@@ -314,20 +315,10 @@ void pxtnWoice::_UpdateWavePTV( pxtnVOICEUNIT* p_vc, pxtnVOICEINSTANCE* p_vi, in
 	else
 	{
 		int16_t* p = (int16_t*)p_vi->p_smp_w;
-		for( int32_t s = 0; s < p_vi->smp_body_w; s++ )
-		{
-			if( b_ovt ) osc = osci.GetOneSample_Overtone ( s );
-			else        osc = osci.GetOneSample_Coodinate( s );
-			for( int32_t c = 0; c < ch; c++ )
-			{
-				work = osc * pan_volume[ c ] / 64;
-				if( work >  1.0 ){ work =  1.0; p_vi->b_sine_over = true; }
-				if( work < -1.0 ){ work = -1.0; p_vi->b_sine_over = true; }
-				long_  = (int32_t )( work * 32767 );
-				p[ s * ch + c ] = (int16_t)long_;
-			}
-		}
+		if( b_ovt ) return osci.Render_Overtone ( p, p_vi->smp_body_w, ch, pan_volume, &p_vi->b_sine_over );
+		else        return osci.Render_Coodinate( p, p_vi->smp_body_w, ch, pan_volume, &p_vi->b_sine_over );
 	}
+	return true;
 }
 
 pxtnERR pxtnWoice::Tone_Ready_sample( const pxtnPulse_NoiseBuilder *ptn_bldr )
@@ -387,9 +378,9 @@ pxtnERR pxtnWoice::Tone_Ready_sample( const pxtnPulse_NoiseBuilder *ptn_bldr )
 			{
 				p_vi->smp_body_w =  400;
 				int32_t size = p_vi->smp_body_w * ch * bps / 8;
-				if( !( p_vi->p_smp_w = (uint8_t*)malloc( size ) ) ){ res = pxtnERR_memory; goto term; }
+				if( !( p_vi->p_smp_w = (uint8_t*)pxtnMem_alloc( size, pxtnMEM_voice ) ) ){ res = pxtnERR_memory; goto term; }
 				memset( p_vi->p_smp_w, 0x00, size );
-				_UpdateWavePTV( p_vc, p_vi, ch, sps, bps );
+				if( !_UpdateWavePTV( p_vc, p_vi, ch, sps, bps ) ){ res = pxtnERR_memory; goto term; }
 				break;
 			}
 
@@ -423,7 +414,7 @@ term:
 	return res;
 }
 
-pxtnERR pxtnWoice::Tone_Ready_envelope( int32_t sps )
+pxtnERR pxtnWoice::Tone_Ready_envelope( int32_t sps, bool b_env_table )
 {
 	pxtnERR    res     = pxtnERR_VOID;
 	int32_t    e       =            0;
@@ -436,7 +427,9 @@ pxtnERR pxtnWoice::Tone_Ready_envelope( int32_t sps )
 		pxtnVOICEENVELOPE* p_enve = &p_vc->envelope;
 		int32_t            size   =               0;
 
-		pxtnMem_free( (void**)&p_vi->p_env );
+		pxtnMem_free( (void**)&p_vi->p_env     );
+		pxtnMem_free( (void**)&p_vi->p_env_seg );
+		p_vi->env_seg_num = 0;
 
 		if( p_enve->head_num )
 		{
@@ -444,8 +437,10 @@ pxtnERR pxtnWoice::Tone_Ready_envelope( int32_t sps )
             p_vi->env_size = (int32_t)trunc( (double)size * sps / p_enve->fps );
 			if( !p_vi->env_size ) p_vi->env_size = 1;
 
-			if( !pxtnMem_zero_alloc( (void**)&p_vi->p_env, p_vi->env_size                       ) ){ res = pxtnERR_memory; goto term; }
-			if( !pxtnMem_zero_alloc( (void**)&p_point    , sizeof(pxtnPOINT) * p_enve->head_num ) ){ res = pxtnERR_memory; goto term; }
+			if( b_env_table &&
+				!pxtnMem_zero_alloc( (void**)&p_vi->p_env    , p_vi->env_size                                         , pxtnMEM_envelope ) ){ res = pxtnERR_memory; goto term; }
+			if( !pxtnMem_zero_alloc( (void**)&p_vi->p_env_seg, sizeof(pxtnVOICEENVSEGMENT) * ( p_enve->head_num + 1 ), pxtnMEM_envelope ) ){ res = pxtnERR_memory; goto term; }
+			if( !pxtnMem_zero_alloc( (void**)&p_point        , sizeof(pxtnPOINT) * p_enve->head_num                   , pxtnMEM_envelope ) ){ res = pxtnERR_memory; goto term; }
 
 			// convert points.
 			int32_t  offset   = 0;
@@ -462,8 +457,37 @@ pxtnERR pxtnWoice::Tone_Ready_envelope( int32_t sps )
 			}
 
 			pxtnPOINT start;
+
+			if( p_vi->p_env )
+			{
+				e = start.x = start.y = 0;
+				for( int32_t  s = 0; s < p_vi->env_size; s++ )
+				{
+					while( e < head_num && s >= p_point[ e ].x )
+					{
+						start.x = p_point[ e ].x;
+						start.y = p_point[ e ].y;
+						e++;
+					}
+
+					if(    e < head_num )
+					{
+						p_vi->p_env[ s ] = (uint8_t)(
+													start.y + ( p_point[ e ].y - start.y ) *
+													(              s - start.x ) /
+													( p_point[ e ].x - start.x ) );
+					}
+					else
+					{
+						p_vi->p_env[ s ] = (uint8_t)start.y;
+					}
+				}
+			}
+
+			// same walk as the table, one segment per point.
+			// dy * ( s - start.x ) / dx is kept as quotient + remainder so Tone_Envelope only adds.
 			e = start.x = start.y = 0;
-			for( int32_t  s = 0; s < p_vi->env_size; s++ )
+			for( int32_t  s = 0; s < p_vi->env_size; )
 			{
 				while( e < head_num && s >= p_point[ e ].x )
 				{
@@ -472,17 +496,30 @@ pxtnERR pxtnWoice::Tone_Ready_envelope( int32_t sps )
 					e++;
 				}
 
-				if(    e < head_num )
+				pxtnVOICEENVSEGMENT* p_seg = &p_vi->p_env_seg[ p_vi->env_seg_num++ ];
+				p_seg->y = start.y;
+
+				if( e < head_num )
 				{
-					p_vi->p_env[ s ] = (uint8_t)(
-												start.y + ( p_point[ e ].y - start.y ) *
-												(              s - start.x ) /
-												( p_point[ e ].x - start.x ) );
+					int32_t dy  = p_point[ e ].y - start.y;
+					int32_t ady = dy < 0 ? -dy : dy;
+					int32_t a   = ady * ( s - start.x );
+
+					p_seg->dx     = p_point[ e ].x - start.x;
+					p_seg->step_q = dy  / p_seg->dx;
+					p_seg->step_r = ady % p_seg->dx;
+					p_seg->carry  = dy < 0 ? -1 : 1;
+					p_seg->init_q = ( a / p_seg->dx ) * p_seg->carry;
+					p_seg->init_r =   a % p_seg->dx;
+					s = p_point[ e ].x;
+					if( s > p_vi->env_size ) s = p_vi->env_size;
 				}
 				else
 				{
-					p_vi->p_env[ s ] = (uint8_t)start.y;
+					p_seg->dx = 1;
+					s = p_vi->env_size;
 				}
+				p_seg->smp_end = s;
 			}
 
 			pxtnMem_free( (void**)&p_point );
@@ -503,15 +540,23 @@ term:
 
 	pxtnMem_free( (void**)&p_point );
 
-	if( res != pxtnOK ){ for( int32_t v = 0; v < _voice_num; v++ ) pxtnMem_free( (void**)&_voinsts[ v ].p_env ); }
+	if( res != pxtnOK )
+	{
+		for( int32_t v = 0; v < _voice_num; v++ )
+		{
+			pxtnMem_free( (void**)&_voinsts[ v ].p_env     );
+			pxtnMem_free( (void**)&_voinsts[ v ].p_env_seg );
+			_voinsts[ v ].env_seg_num = 0;
+		}
+	}
 
 	return res;
 }
 
-pxtnERR pxtnWoice::Tone_Ready( const pxtnPulse_NoiseBuilder *ptn_bldr, int32_t sps )
+pxtnERR pxtnWoice::Tone_Ready( const pxtnPulse_NoiseBuilder *ptn_bldr, int32_t sps, bool b_env_table )
 {
 	pxtnERR res = pxtnERR_VOID;
-	res = Tone_Ready_sample  ( ptn_bldr ); if( res != pxtnOK ) return res;
-	res = Tone_Ready_envelope( sps      ); if( res != pxtnOK ) return res;
+	res = Tone_Ready_sample  ( ptn_bldr         ); if( res != pxtnOK ) return res;
+	res = Tone_Ready_envelope( sps, b_env_table ); if( res != pxtnOK ) return res;
 	return pxtnOK;
 }
@@ -44,6 +44,20 @@ enum pxtnVOICETYPE
 	pxtnVOICE_OggVorbis,
 };
 
+// one piece of the attack envelope, stepped without division.
+typedef struct
+{
+	int32_t  smp_end; // exclusive.
+	int32_t  y      ;
+	int32_t  dx     ;
+	int32_t  step_q ;
+	int32_t  step_r ;
+	int32_t  carry  ;
+	int32_t  init_q ;
+	int32_t  init_r ;
+}
+pxtnVOICEENVSEGMENT;
+
 typedef struct
 {
 	int32_t  smp_head_w ;
@@ -51,10 +65,13 @@ typedef struct
 	int32_t  smp_tail_w ;
 	uint8_t* p_smp_w    ;
 
-	uint8_t* p_env      ;
+	uint8_t* p_env      ; // NULL unless the table was requested.
 	int32_t  env_size   ;
 	int32_t  env_release;
 
+	pxtnVOICEENVSEGMENT* p_env_seg  ;
+	int32_t              env_seg_num;
+
 	bool     b_sine_over;
 }
 pxtnVOICEINSTANCE;
@@ -101,6 +118,8 @@ pxtnVOICEUNIT;
 typedef struct
 {
 	double  smp_pos    ;       
+	int64_t smp_pos_fx ; // 32.32, fixed phase mode.
+	int64_t smp_step_fx;
 	float   offset_freq;
 	int32_t env_volume ;
 	int32_t life_count ;
@@ -111,6 +130,10 @@ typedef struct
 	int32_t env_pos    ;
 	int32_t env_release_clock;
 
+	int32_t env_seg    ;
+	int32_t env_quo    ;
+	int32_t env_rem    ;
+
 	int32_t smooth_volume;
 }
 pxtnVOICETONE;
@@ -141,7 +164,7 @@ private:
 	pxtnERR _Read_Wave     ( void* desc, pxtnVOICEUNIT *p_vc );
 	pxtnERR _Read_Envelope ( void* desc, pxtnVOICEUNIT *p_vc );
 
-	void    _UpdateWavePTV( pxtnVOICEUNIT* p_vc, pxtnVOICEINSTANCE* p_vi, int32_t  ch, int32_t  sps, int32_t  bps );
+	bool    _UpdateWavePTV( pxtnVOICEUNIT* p_vc, pxtnVOICEINSTANCE* p_vi, int32_t  ch, int32_t  sps, int32_t  bps );
 
 
 public :
@@ -186,8 +209,8 @@ public :
 #endif
 
 	pxtnERR Tone_Ready_sample  ( const pxtnPulse_NoiseBuilder *ptn_bldr  );
-	pxtnERR Tone_Ready_envelope( int32_t sps );
-	pxtnERR Tone_Ready         ( const pxtnPulse_NoiseBuilder *ptn_bldr, int32_t sps );
+	pxtnERR Tone_Ready_envelope( int32_t sps, bool b_env_table );
+	pxtnERR Tone_Ready         ( const pxtnPulse_NoiseBuilder *ptn_bldr, int32_t sps, bool b_env_table );
 };
 
 #endif
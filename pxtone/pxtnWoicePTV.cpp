@@ -167,7 +167,7 @@ pxtnERR pxtnWoice::_Read_Envelope( void* desc, pxtnVOICEUNIT *p_vc )
 	if( p_vc->envelope.tail_num != 1            ){ res = pxtnERR_fmt_unknown; goto term; }
 
 	num = p_vc->envelope.head_num + p_vc->envelope.body_num + p_vc->envelope.tail_num;
-	if( !pxtnMem_zero_alloc( (void **)&p_vc->envelope.points, sizeof(pxtnPOINT) * num ) ){ res = pxtnERR_memory; goto term; }
+	if( !pxtnMem_zero_alloc( (void **)&p_vc->envelope.points, sizeof(pxtnPOINT) * num, pxtnMEM_envelope ) ){ res = pxtnERR_memory; goto term; }
 	for( i = 0; i < num; i++ )
 	{
 		if( !_data_r_v( desc, &p_vc->envelope.points[ i ].x ) ){ res = pxtnERR_desc_r; goto term; }
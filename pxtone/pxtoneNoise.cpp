@@ -74,8 +74,10 @@ bool pxtoneNoise::generate( void* desc, void **pp_buf, int32_t *p_size ) const
 	if( noise->read( desc ) != pxtnOK ) goto End;
 	if( !( pcm = bldr->BuildNoise( noise, _ch_num, _sps, _bps ) ) ) goto End;
 
+	// the caller frees *pp_buf, so it is not one of pxtnMem's blocks.
 	*p_size = pcm->get_buf_size();
-	*pp_buf = pcm->Devolve_SamplingBuffer();
+	if( !( *pp_buf = malloc( *p_size ) ) ) goto End;
+	memcpy( *pp_buf, pcm->get_p_buf(), *p_size );
 
 	b_ret = true;
 End:
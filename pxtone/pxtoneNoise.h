@@ -25,7 +25,7 @@ public:
 	bool quality_set( int32_t    ch_num, int32_t    sps, int32_t    bps );
 	void quality_get( int32_t *p_ch_num, int32_t *p_sps, int32_t *p_bps ) const;
 
-	bool generate   ( void* desc, void **pp_buf, int32_t *p_size ) const;
+	bool generate   ( void* desc, void **pp_buf, int32_t *p_size ) const; // free( *pp_buf ).
 };
 
 #endif